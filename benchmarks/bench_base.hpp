@@ -0,0 +1,863 @@
+#include "luacpp/luacpp.h"
+#include "bench_common.h"
+#include <stdio.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sstream>
+#include <iterator>
+using namespace luacpp;
+
+static int RawAdd(lua_State* l) {
+    lua_pushinteger(l, lua_tointeger(l, 1) + lua_tointeger(l, 2));
+    return 1;
+}
+
+static int Add(int a, int b) {
+    return a + b;
+}
+
+/* ---------------------- c++ functions called from c++ --------------------- */
+
+static void BenchCFunctionFromC(vector<BenchResult>* results) {
+    // the baseline keeps the function in the registry like `LuaFunction` does
+    lua_State* raw = NewCountingState();
+    lua_pushcclosure(raw, RawAdd, 0);
+    const int ref = luaL_ref(raw, LUA_REGISTRYINDEX);
+    results->push_back(
+        RunBench("raw_cfunction_pcall", nullptr, [raw, ref](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                lua_rawgeti(raw, LUA_REGISTRYINDEX, ref);
+                lua_pushinteger(raw, (lua_Integer)i);
+                lua_pushinteger(raw, (lua_Integer)i);
+                lua_pcall(raw, 2, 1, 0);
+                lua_tointeger(raw, -1);
+                lua_pop(raw, 1);
+            }
+        }));
+    lua_close(raw);
+
+    LuaState l(NewCountingState(), true);
+    auto lfunc = l.CreateFunction([](int a, int b) -> int {
+        return a + b;
+    });
+    results->push_back(RunBench(
+        "luafunction_execute_cfunction", "raw_cfunction_pcall",
+        [&lfunc](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                lfunc.Execute(
+                    [](uint32_t, const LuaObject& lobj) -> bool {
+                        lobj.ToInteger();
+                        return true;
+                    },
+                    nullptr, (int)i, (int)i);
+            }
+        }));
+}
+
+/* ----------------------- c++ functions called from lua -------------------- */
+
+static void BenchCFunctionFromLua(vector<BenchResult>* results) {
+    LuaState l(NewCountingState(), true);
+
+    l.CreateFunction(RawAdd, "raw_add");
+    l.CreateFunction(Add, "ptr_add");
+    l.CreateFunction<decltype(&Add), &Add>("static_add");
+    l.CreateFunction(
+        [](int a, int b) -> int {
+            return a + b;
+        },
+        "lambda_add");
+    int offset = 0;
+    l.CreateFunction(
+        [offset](int a, int b) -> int {
+            return a + b + offset;
+        },
+        "capture_add");
+
+    l.DoString(
+        "function bench_raw(n) for i = 1, n do raw_add(i, i) end end;"
+        "function bench_ptr(n) for i = 1, n do ptr_add(i, i) end end;"
+        "function bench_static(n) for i = 1, n do static_add(i, i) end end;"
+        "function bench_lambda(n) for i = 1, n do lambda_add(i, i) end end;"
+        "function bench_capture(n) for i = 1, n do capture_add(i, i) end end");
+
+    auto bench_raw = l.GetFunction("bench_raw");
+    results->push_back(
+        RunBench("raw_cfunction_from_lua", nullptr, [&bench_raw](uint64_t n) {
+            bench_raw.Execute(nullptr, nullptr, n);
+        }));
+
+    auto bench_ptr = l.GetFunction("bench_ptr");
+    results->push_back(RunBench("generic_function_ptr_from_lua",
+                                "raw_cfunction_from_lua",
+                                [&bench_ptr](uint64_t n) {
+                                    bench_ptr.Execute(nullptr, nullptr, n);
+                                }));
+
+    auto bench_static = l.GetFunction("bench_static");
+    results->push_back(RunBench("static_function_from_lua",
+                                "raw_cfunction_from_lua",
+                                [&bench_static](uint64_t n) {
+                                    bench_static.Execute(nullptr, nullptr, n);
+                                }));
+
+    auto bench_lambda = l.GetFunction("bench_lambda");
+    results->push_back(RunBench("generic_function_lambda_from_lua",
+                                "raw_cfunction_from_lua",
+                                [&bench_lambda](uint64_t n) {
+                                    bench_lambda.Execute(nullptr, nullptr, n);
+                                }));
+
+    auto bench_capture = l.GetFunction("bench_capture");
+    results->push_back(RunBench("generic_function_capture_lambda_from_lua",
+                                "raw_cfunction_from_lua",
+                                [&bench_capture](uint64_t n) {
+                                    bench_capture.Execute(nullptr, nullptr, n);
+                                }));
+}
+
+/* ----------------------- lua functions called from c++ -------------------- */
+
+static void BenchLuaFunctionFromC(vector<BenchResult>* results) {
+    const char* chunk = "function lua_add(a, b) return a + b end";
+
+    lua_State* raw = NewCountingState();
+    luaL_loadstring(raw, chunk);
+    lua_pcall(raw, 0, 0, 0);
+    lua_getglobal(raw, "lua_add");
+    const int ref = luaL_ref(raw, LUA_REGISTRYINDEX);
+    results->push_back(
+        RunBench("raw_lua_function_pcall", nullptr, [raw, ref](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                lua_rawgeti(raw, LUA_REGISTRYINDEX, ref);
+                lua_pushinteger(raw, (lua_Integer)i);
+                lua_pushinteger(raw, (lua_Integer)i);
+                lua_pcall(raw, 2, 1, 0);
+                lua_tointeger(raw, -1);
+                lua_pop(raw, 1);
+            }
+        }));
+    lua_close(raw);
+
+    LuaState l(NewCountingState(), true);
+    l.DoString(chunk);
+    auto lfunc = l.GetFunction("lua_add");
+    results->push_back(RunBench(
+        "luafunction_execute_lua_function", "raw_lua_function_pcall",
+        [&lfunc](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                lfunc.Execute(
+                    [](uint32_t, const LuaObject& lobj) -> bool {
+                        lobj.ToInteger();
+                        return true;
+                    },
+                    nullptr, (int)i, (int)i);
+            }
+        }));
+    results->push_back(RunBench(
+        "luafunction_call_lua_function", "raw_lua_function_pcall",
+        [&lfunc](uint64_t n) {
+            std::tuple<int> res;
+            for (uint64_t i = 0; i < n; ++i) {
+                lfunc.Call(&res, nullptr, (int)i, (int)i);
+            }
+        }));
+}
+
+/* --------------------- lua functions called in batches -------------------- */
+
+// [0, n) without allocating any memory
+struct IndexRange final {
+    struct Iterator final {
+        uint64_t operator*() const {
+            return i;
+        }
+        Iterator& operator++() {
+            ++i;
+            return *this;
+        }
+        bool operator!=(const Iterator& rhs) const {
+            return (i != rhs.i);
+        }
+        uint64_t i;
+    };
+
+    Iterator begin() const {
+        return Iterator{0};
+    }
+    Iterator end() const {
+        return Iterator{n};
+    }
+
+    uint64_t n;
+};
+
+static void BenchLuaFunctionBatch(vector<BenchResult>* results) {
+    const char* chunk = "function on_record(a) return a + 1 end";
+
+    // the function is pinned on the stack like `ForEachCall()` does
+    lua_State* raw = NewCountingState();
+    luaL_loadstring(raw, chunk);
+    lua_pcall(raw, 0, 0, 0);
+    results->push_back(
+        RunBench("raw_lua_function_batch", nullptr, [raw](uint64_t n) {
+            lua_getglobal(raw, "on_record");
+            for (uint64_t i = 0; i < n; ++i) {
+                lua_pushvalue(raw, -1);
+                lua_pushinteger(raw, (lua_Integer)i);
+                lua_pcall(raw, 1, 1, 0);
+                lua_tointeger(raw, -1);
+                lua_pop(raw, 1);
+            }
+            lua_pop(raw, 1);
+        }));
+    lua_close(raw);
+
+    LuaState l(NewCountingState(), true);
+    l.DoString(chunk);
+    auto lfunc = l.GetFunction("on_record");
+    results->push_back(RunBench(
+        "luafunction_execute_per_record", "raw_lua_function_batch",
+        [&lfunc](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                lfunc.Execute(
+                    [](uint32_t, const LuaObject& lobj) -> bool {
+                        lobj.ToInteger();
+                        return true;
+                    },
+                    nullptr, (lua_Integer)i);
+            }
+        }));
+    results->push_back(RunBench(
+        "luafunction_foreach_call", "raw_lua_function_batch",
+        [&lfunc](uint64_t n) {
+            lfunc.ForEachCall(
+                IndexRange{n},
+                [](uint64_t i) -> lua_Integer {
+                    return (lua_Integer)i;
+                },
+                [](uint64_t, lua_Integer) -> bool {
+                    return true;
+                });
+        }));
+}
+
+/* ------------------------------ scalar objects ---------------------------- */
+
+static void BenchObjectScalar(vector<BenchResult>* results) {
+    LuaState l(NewCountingState(), true);
+    l.DoString("t = {5}");
+    auto tbl = l.GetTable("t");
+
+    results->push_back(
+        RunBench("luatable_get_integer", nullptr, [&tbl](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                tbl.GetInteger(1);
+            }
+        }));
+    results->push_back(RunBench("luatable_get_object_to_integer",
+                                "luatable_get_integer", [&tbl](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        tbl.Get(1).ToInteger();
+                                    }
+                                }));
+
+    auto lobj = l.CreateInteger(5);
+    results->push_back(
+        RunBench("luaobject_copy_integer", nullptr, [&lobj](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                LuaObject copy(lobj);
+                copy.ToInteger();
+            }
+        }));
+}
+
+/* ------------------------------ object copies ----------------------------- */
+
+static void BenchObjectCopy(vector<BenchResult>* results) {
+    lua_State* raw = NewCountingState();
+    lua_newtable(raw);
+    results->push_back(
+        RunBench("raw_ref_unref_table", nullptr, [raw](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                lua_pushvalue(raw, -1);
+                auto ref = luaL_ref(raw, LUA_REGISTRYINDEX);
+                luaL_unref(raw, LUA_REGISTRYINDEX, ref);
+            }
+        }));
+    lua_close(raw);
+
+    LuaState l(NewCountingState(), true);
+    auto tbl = l.CreateTable();
+    // shares the reference with `tbl`
+    LuaTable first_copy(tbl);
+
+    results->push_back(RunBench("luatable_copy", "raw_ref_unref_table",
+                                [&tbl](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        LuaTable copy(tbl);
+                                    }
+                                }));
+
+    results->push_back(RunBench("luatable_copy_into_vector_16", nullptr,
+                                [&tbl](uint64_t n) {
+                                    vector<LuaTable> copies;
+                                    copies.reserve(16);
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        for (int j = 0; j < 16; ++j) {
+                                            copies.push_back(tbl);
+                                        }
+                                        copies.clear();
+                                    }
+                                }));
+}
+
+/* ----------------------------- temporary objects -------------------------- */
+
+static void BenchObjectScope(vector<BenchResult>* results) {
+    LuaState l(NewCountingState(), true);
+    l.DoString("arr = {}; for i = 1, 100 do arr[i] = 'item' .. i end");
+    auto tbl = l.GetTable("arr");
+
+    results->push_back(
+        RunBench("luatable_get_temp_objects_100", nullptr, [&tbl](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                for (int j = 1; j <= 100; ++j) {
+                    tbl.Get(j).ToStringRef();
+                }
+            }
+        }));
+    results->push_back(RunBench("luatable_get_temp_objects_in_scope_100",
+                                "luatable_get_temp_objects_100",
+                                [&l, &tbl](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        LuaScope scope(l);
+                                        for (int j = 1; j <= 100; ++j) {
+                                            scope.Get(tbl, j).ToStringRef();
+                                        }
+                                    }
+                                }));
+}
+
+/* ----------------------------- table iteration ---------------------------- */
+
+// one call iterates an array of 100 numbers
+static void BenchTableForEach(vector<BenchResult>* results) {
+    const char* chunk = "arr = {}; for i = 1, 100 do arr[i] = i * 1.5 end";
+
+    lua_State* raw = NewCountingState();
+    luaL_loadstring(raw, chunk);
+    lua_pcall(raw, 0, 0, 0);
+    lua_getglobal(raw, "arr");
+    const int ref = luaL_ref(raw, LUA_REGISTRYINDEX);
+    results->push_back(
+        RunBench("raw_table_iterate_100", nullptr, [raw, ref](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                lua_rawgeti(raw, LUA_REGISTRYINDEX, ref);
+                auto len = lua_rawlen(raw, -1);
+                for (lua_Integer j = 1; j <= (lua_Integer)len; ++j) {
+                    lua_rawgeti(raw, -1, j);
+                    lua_tonumber(raw, -1);
+                    lua_pop(raw, 1);
+                }
+                lua_pop(raw, 1);
+            }
+        }));
+    lua_close(raw);
+
+    LuaState l(NewCountingState(), true);
+    l.DoString(chunk);
+    auto tbl = l.GetTable("arr");
+
+    results->push_back(RunBench(
+        "luatable_foreach_array_100", "raw_table_iterate_100",
+        [&tbl](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                tbl.ForEach([](uint32_t, const LuaObject& value) -> bool {
+                    value.ToNumber();
+                    return true;
+                });
+            }
+        }));
+
+    results->push_back(RunBench(
+        "luatable_foreach_kv_100", "raw_table_iterate_100",
+        [&tbl](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                tbl.ForEach(
+                    [](const LuaObject& key, const LuaObject& value) -> bool {
+                        key.ToInteger();
+                        value.ToNumber();
+                        return true;
+                    });
+            }
+        }));
+
+    results->push_back(RunBench(
+        "luatable_foreach_array_number_100", "raw_table_iterate_100",
+        [&tbl](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                tbl.ForEach([](uint32_t, double) -> bool {
+                    return true;
+                });
+            }
+        }));
+
+    results->push_back(RunBench(
+        "luatable_foreach_kv_number_100", "raw_table_iterate_100",
+        [&tbl](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                tbl.ForEach([](lua_Integer, double) -> bool {
+                    return true;
+                });
+            }
+        }));
+}
+
+/* ------------------------------ bulk arrays ------------------------------- */
+
+static void BenchTableArray(vector<BenchResult>* results) {
+    const vector<double> values(100, 1.5);
+
+    LuaState l(NewCountingState(), true);
+
+    results->push_back(
+        RunBench("luatable_set_number_100", nullptr, [&l, &values](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                auto tbl = l.CreateTable();
+                for (size_t j = 0; j < values.size(); ++j) {
+                    tbl.SetNumber(j + 1, values[j]);
+                }
+            }
+        }));
+    results->push_back(RunBench("luastate_create_array_100",
+                                "luatable_set_number_100",
+                                [&l, &values](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        l.CreateArray(values);
+                                    }
+                                }));
+
+    auto tbl = l.CreateArray(values);
+    results->push_back(
+        RunBench("luatable_get_number_100", nullptr, [&tbl](uint64_t n) {
+            vector<double> out(100);
+            for (uint64_t i = 0; i < n; ++i) {
+                for (size_t j = 0; j < out.size(); ++j) {
+                    out[j] = tbl.GetNumber(j + 1);
+                }
+            }
+        }));
+    results->push_back(RunBench("luatable_copy_to_100",
+                                "luatable_get_number_100", [&tbl](uint64_t n) {
+                                    vector<double> out(100);
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        tbl.CopyTo(out.data(), out.size());
+                                    }
+                                }));
+}
+
+/* ----------------------------- interned keys ------------------------------ */
+
+static void BenchTableKey(vector<BenchResult>* results) {
+    LuaState l(NewCountingState(), true);
+
+    // 50 config entries read by name
+    const uint32_t key_num = 50;
+    vector<string> names;
+    string chunk = "config = {";
+    for (uint32_t i = 0; i < key_num; ++i) {
+        names.push_back("config_entry_" + std::to_string(i));
+        chunk += names.back() + " = " + std::to_string(i) + ", ";
+    }
+    chunk += "}";
+    l.DoString(chunk.c_str());
+
+    auto tbl = l.GetTable("config");
+    results->push_back(RunBench("luatable_get_integer_by_name_50", nullptr,
+                                [&tbl, &names](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        for (auto& name : names) {
+                                            tbl.GetInteger(name.c_str());
+                                        }
+                                    }
+                                }));
+
+    // names are copied to a transient buffer like being parsed from requests
+    results->push_back(RunBench("luatable_get_integer_by_copied_name_50",
+                                "luatable_get_integer_by_name_50",
+                                [&tbl, &names](uint64_t n) {
+                                    char buf[32];
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        for (auto& name : names) {
+                                            memcpy(buf, name.c_str(),
+                                                   name.size() + 1);
+                                            tbl.GetInteger(buf);
+                                        }
+                                    }
+                                }));
+
+    vector<LuaKey> keys;
+    for (auto& name : names) {
+        keys.push_back(l.CreateKey(name.c_str()));
+    }
+    results->push_back(RunBench("luatable_get_integer_by_key_50",
+                                "luatable_get_integer_by_name_50",
+                                [&tbl, &keys](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        for (auto& key : keys) {
+                                            tbl.GetInteger(key);
+                                        }
+                                    }
+                                }));
+
+    l.DoString("for k, v in pairs(config) do _G[k] = v end");
+    results->push_back(RunBench("luastate_get_integer_by_name_50", nullptr,
+                                [&l, &names](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        for (auto& name : names) {
+                                            l.GetInteger(name.c_str());
+                                        }
+                                    }
+                                }));
+    results->push_back(RunBench("luastate_get_integer_by_key_50",
+                                "luastate_get_integer_by_name_50",
+                                [&l, &keys](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        for (auto& key : keys) {
+                                            l.GetInteger(key);
+                                        }
+                                    }
+                                }));
+}
+
+/* ------------------------------ table cursors ----------------------------- */
+
+static void BenchTableCursor(vector<BenchResult>* results) {
+    LuaState l(NewCountingState(), true);
+
+    // a record with 40 fields
+    vector<string> names;
+    for (uint32_t i = 0; i < 40; ++i) {
+        names.push_back("field_" + std::to_string(i));
+    }
+    auto tbl = l.CreateTable();
+
+    results->push_back(RunBench("luatable_set_integer_fields_40", nullptr,
+                                [&tbl, &names](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        for (auto& name : names) {
+                                            tbl.SetInteger(name.c_str(), i);
+                                        }
+                                    }
+                                }));
+    results->push_back(RunBench("luatable_cursor_set_integer_fields_40",
+                                "luatable_set_integer_fields_40",
+                                [&tbl, &names](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        auto cursor = tbl.Pin();
+                                        for (auto& name : names) {
+                                            cursor.SetInteger(name.c_str(), i);
+                                        }
+                                    }
+                                }));
+
+    results->push_back(RunBench("luatable_get_integer_fields_40", nullptr,
+                                [&tbl, &names](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        for (auto& name : names) {
+                                            tbl.GetInteger(name.c_str());
+                                        }
+                                    }
+                                }));
+    results->push_back(RunBench("luatable_cursor_get_integer_fields_40",
+                                "luatable_get_integer_fields_40",
+                                [&tbl, &names](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        auto cursor = tbl.Pin();
+                                        for (auto& name : names) {
+                                            cursor.GetInteger(name.c_str());
+                                        }
+                                    }
+                                }));
+}
+
+/* ------------------------------- table paths ------------------------------ */
+
+static void BenchTablePath(vector<BenchResult>* results) {
+    LuaState l(NewCountingState(), true);
+    l.DoString("cfg = {upstream = {pool = {max_conns = 64}}}");
+
+    results->push_back(RunBench("luastate_get_nested_integer_chained", nullptr,
+                                [&l](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        l.GetTable("cfg")
+                                            .GetTable("upstream")
+                                            .GetTable("pool")
+                                            .GetInteger("max_conns");
+                                    }
+                                }));
+
+    LuaPath path;
+    l.CreatePath("cfg.upstream.pool.max_conns", &path);
+    results->push_back(RunBench("luastate_get_nested_integer_by_path",
+                                "luastate_get_nested_integer_chained",
+                                [&l, &path](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        l.GetInteger(path);
+                                    }
+                                }));
+}
+
+/* ------------------------- table arguments from lua ----------------------- */
+
+static void BenchTableArgument(vector<BenchResult>* results) {
+    LuaState l(NewCountingState(), true);
+
+    l.CreateFunction(
+        [](const LuaTable& tbl) -> lua_Integer {
+            return tbl.GetInteger(1);
+        },
+        "ref_arg");
+    l.CreateFunction(
+        [](const LuaStackTable& tbl) -> lua_Integer {
+            return tbl.GetInteger(1);
+        },
+        "stack_arg");
+
+    l.DoString(
+        "t = {1, 2, 3};"
+        "function bench_ref(n) for i = 1, n do ref_arg(t) end end;"
+        "function bench_stack(n) for i = 1, n do stack_arg(t) end end");
+
+    auto bench_ref = l.GetFunction("bench_ref");
+    results->push_back(
+        RunBench("luatable_argument_from_lua", "raw_cfunction_from_lua",
+                 [&bench_ref](uint64_t n) {
+                     bench_ref.Execute(nullptr, nullptr, n);
+                 }));
+
+    auto bench_stack = l.GetFunction("bench_stack");
+    results->push_back(
+        RunBench("luastacktable_argument_from_lua", "raw_cfunction_from_lua",
+                 [&bench_stack](uint64_t n) {
+                     bench_stack.Execute(nullptr, nullptr, n);
+                 }));
+}
+
+/* ------------------------------- allocators ------------------------------- */
+
+// one call creates and drops 100 small tables and strings in lua
+static void BenchStateAllocator(vector<BenchResult>* results) {
+    const char* chunk =
+        "function churn() "
+        "  for i = 1, 100 do local t = {x = i, y = 'v' .. i} end "
+        "end";
+
+    LuaState def(luaL_newstate(), true);
+    def.DoString(chunk);
+    auto def_churn = def.GetFunction("churn");
+    results->push_back(RunBench("default_allocator_churn_100", nullptr,
+                                [&def_churn](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        def_churn.Execute();
+                                    }
+                                }));
+
+    auto slab = LuaState::NewWithSlabAllocator();
+    slab->DoString(chunk);
+    auto slab_churn = slab->GetFunction("churn");
+    results->push_back(RunBench("slab_allocator_churn_100",
+                                "default_allocator_churn_100",
+                                [&slab_churn](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        slab_churn.Execute();
+                                    }
+                                }));
+
+    auto limited = LuaState::NewWithMemoryLimit(64 * 1024 * 1024,
+                                                128 * 1024 * 1024);
+    limited->DoString(chunk);
+    auto limited_churn = limited->GetFunction("churn");
+    results->push_back(RunBench("memory_limit_allocator_churn_100",
+                                "default_allocator_churn_100",
+                                [&limited_churn](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        limited_churn.Execute();
+                                    }
+                                }));
+}
+
+// one call creates a state, runs a short script and destroys the state
+static void BenchStateDisposable(vector<BenchResult>* results) {
+    const char* chunk =
+        "local t = {} "
+        "for i = 1, 1000 do t[i] = {id = i, name = 'item' .. i} end";
+
+    results->push_back(
+        RunBench("default_state_lifetime", nullptr, [chunk](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                LuaState l(luaL_newstate(), true);
+                l.DoString(chunk);
+            }
+        }));
+    results->push_back(RunBench("disposable_state_lifetime",
+                                "default_state_lifetime", [chunk](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        auto l = LuaState::NewDisposable();
+                                        l->DoString(chunk);
+                                    }
+                                }));
+}
+
+/* ----------------------------- bytecode cache ----------------------------- */
+
+// one call loads and runs a script of 1000 functions
+static void BenchDoFileCache(vector<BenchResult>* results) {
+    char tmpl[] = "/tmp/luacpp_bench_XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        return;
+    }
+    const string dir = tmpl;
+    const string script = dir + "/script.lua";
+
+    FILE* fp = fopen(script.c_str(), "w");
+    for (int i = 0; i < 1000; ++i) {
+        fprintf(fp,
+                "function f%d(a, b)\n"
+                "    local t = {x = a, y = b, name = 'f%d'}\n"
+                "    if a > b then return t.x - t.y else return t.y end\n"
+                "end\n",
+                i, i);
+    }
+    fclose(fp);
+
+    LuaState l(luaL_newstate(), true);
+    results->push_back(
+        RunBench("dofile_source_1000", nullptr, [&l, &script](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                l.DoFile(script.c_str());
+            }
+        }));
+
+    l.SetBytecodeCacheDir(dir.c_str());
+    results->push_back(RunBench("dofile_bytecode_cache_1000",
+                                "dofile_source_1000",
+                                [&l, &script](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        l.DoFile(script.c_str());
+                                    }
+                                }));
+
+    DIR* dp = opendir(dir.c_str());
+    for (auto ent = readdir(dp); ent; ent = readdir(dp)) {
+        if (ent->d_name[0] != '.') {
+            remove((dir + "/" + ent->d_name).c_str());
+        }
+    }
+    closedir(dp);
+    rmdir(dir.c_str());
+}
+
+/* ------------------------------ mapped files ------------------------------ */
+
+// one call loads a generated data script of about 150kb
+static void BenchDoMapped(vector<BenchResult>* results) {
+    char tmpl[] = "/tmp/luacpp_bench_XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        return;
+    }
+    const string dir = tmpl;
+    const string script = dir + "/data.lua";
+
+    FILE* fp = fopen(script.c_str(), "w");
+    fprintf(fp, "data = {\n");
+    for (int i = 0; i < 3000; ++i) {
+        fprintf(fp, "    {id = %d, name = 'item_%d', weight = %d.5},\n", i, i,
+                i);
+    }
+    fprintf(fp, "}\n");
+    fclose(fp);
+
+    LuaState l(luaL_newstate(), true);
+    results->push_back(
+        RunBench("dofile_data_150kb", nullptr, [&l, &script](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                l.DoFile(script.c_str());
+            }
+        }));
+    results->push_back(RunBench("domapped_data_150kb", "dofile_data_150kb",
+                                [&l, &script](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        l.DoMapped(script.c_str());
+                                    }
+                                }));
+
+    remove(script.c_str());
+    rmdir(dir.c_str());
+}
+
+/* --------------------------------- streams -------------------------------- */
+
+// one call loads a data script of about 15kb from an istream
+static void BenchDoStream(vector<BenchResult>* results) {
+    string chunk = "data = {\n";
+    for (int i = 0; i < 300; ++i) {
+        chunk += "    {id = " + to_string(i) + ", name = 'item_" +
+            to_string(i) + "', weight = " + to_string(i) + ".5},\n";
+    }
+    chunk += "}\n";
+
+    LuaState l(luaL_newstate(), true);
+    results->push_back(RunBench(
+        "istream_to_string_dostring", nullptr, [&l, &chunk](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                istringstream iss(chunk);
+                string content((istreambuf_iterator<char>(iss)),
+                               istreambuf_iterator<char>());
+                l.DoString(content.c_str());
+            }
+        }));
+    results->push_back(RunBench("istream_dostream",
+                                "istream_to_string_dostring",
+                                [&l, &chunk](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        istringstream iss(chunk);
+                                        l.DoStream(iss, "=data");
+                                    }
+                                }));
+}
+
+/* ------------------------------- chunk cache ------------------------------ */
+
+// one call runs a short rule snippet
+static void BenchDoStringCache(vector<BenchResult>* results) {
+    const char* chunk =
+        "local score = (level or 1) * 10 "
+        "if score > 50 then result = 'high' else result = 'low' end";
+
+    LuaState l(luaL_newstate(), true);
+    results->push_back(
+        RunBench("dostring_compile", nullptr, [&l, chunk](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                l.DoString(chunk);
+            }
+        }));
+
+    l.DoString(("function rule() " + string(chunk) + " end").c_str());
+    auto rule = l.GetFunction("rule");
+    results->push_back(RunBench("luafunction_execute_rule", "dostring_compile",
+                                [&rule](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        rule.Execute();
+                                    }
+                                }));
+
+    l.SetChunkCacheSize(64);
+    results->push_back(RunBench("dostring_chunk_cache", "dostring_compile",
+                                [&l, chunk](uint64_t n) {
+                                    for (uint64_t i = 0; i < n; ++i) {
+                                        l.DoString(chunk);
+                                    }
+                                }));
+}
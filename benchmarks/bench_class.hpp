@@ -0,0 +1,224 @@
+#include "bench_common.h"
+
+/* ------------------------ raw userdata for baselines ---------------------- */
+
+static int RawPointIndex(lua_State* l) {
+    auto p = (BenchPoint*)lua_touserdata(l, 1);
+    const char* key = lua_tostring(l, 2);
+    if (key[0] == 'x' && key[1] == '\0') {
+        lua_pushinteger(l, p->x);
+    } else if (key[0] == 'y' && key[1] == '\0') {
+        lua_pushinteger(l, p->y);
+    } else {
+        lua_getmetatable(l, 1);
+        lua_getfield(l, -1, "methods");
+        lua_getfield(l, -1, key);
+    }
+    return 1;
+}
+
+static int RawPointNewIndex(lua_State* l) {
+    auto p = (BenchPoint*)lua_touserdata(l, 1);
+    const char* key = lua_tostring(l, 2);
+    if (key[0] == 'x' && key[1] == '\0') {
+        p->x = (int)lua_tointeger(l, 3);
+    } else if (key[0] == 'y' && key[1] == '\0') {
+        p->y = (int)lua_tointeger(l, 3);
+    }
+    return 0;
+}
+
+static int RawPointSum(lua_State* l) {
+    auto p = (BenchPoint*)lua_touserdata(l, 1);
+    lua_pushinteger(l, p->Sum());
+    return 1;
+}
+
+static lua_State* NewRawPointState() {
+    lua_State* l = NewCountingState();
+    auto p = lua_newuserdatauv(l, sizeof(BenchPoint), 0);
+    new (p) BenchPoint();
+
+    lua_createtable(l, 0, 3);
+    lua_pushcfunction(l, RawPointIndex);
+    lua_setfield(l, -2, "__index");
+    lua_pushcfunction(l, RawPointNewIndex);
+    lua_setfield(l, -2, "__newindex");
+    lua_createtable(l, 0, 1);
+    lua_pushcfunction(l, RawPointSum);
+    lua_setfield(l, -2, "sum");
+    lua_setfield(l, -2, "methods");
+    lua_setmetatable(l, -2);
+
+    lua_setglobal(l, "p");
+    return l;
+}
+
+static void RunRawChunk(lua_State* l, const char* chunk) {
+    if (luaL_loadstring(l, chunk) != LUA_OK || lua_pcall(l, 0, 0, 0) != LUA_OK) {
+        abort();
+    }
+}
+
+static void RunRawLoop(lua_State* l, uint64_t n) {
+    lua_getglobal(l, "bench_loop");
+    lua_pushinteger(l, (lua_Integer)n);
+    lua_pcall(l, 1, 0, 0);
+}
+
+/* ------------------------------- properties ------------------------------- */
+
+static void BenchClassProperty(vector<BenchResult>* results) {
+    const char* get_chunk =
+        "function bench_loop(n) local v; for i = 1, n do v = p.x end end";
+    const char* set_chunk =
+        "function bench_loop(n) for i = 1, n do p.x = i end end";
+
+    lua_State* raw = NewRawPointState();
+    RunRawChunk(raw, get_chunk);
+    results->push_back(
+        RunBench("raw_userdata_field_get", nullptr, [raw](uint64_t n) {
+            RunRawLoop(raw, n);
+        }));
+    RunRawChunk(raw, set_chunk);
+    results->push_back(
+        RunBench("raw_userdata_field_set", nullptr, [raw](uint64_t n) {
+            RunRawLoop(raw, n);
+        }));
+    lua_close(raw);
+
+    LuaState l(NewCountingState(), true);
+    auto lclass = l.CreateClass<BenchPoint>("BenchPoint")
+                      .DefConstructor()
+                      .DefMember<int>(
+                          "x",
+                          [](const BenchPoint* p) -> int {
+                              return p->x;
+                          },
+                          [](BenchPoint* p, int v) -> void {
+                              p->x = v;
+                          });
+    l.Set("p", lclass.CreateInstance());
+
+    l.DoString(get_chunk);
+    auto get_loop = l.GetFunction("bench_loop");
+    results->push_back(RunBench("luaclass_property_get",
+                                "raw_userdata_field_get",
+                                [&get_loop](uint64_t n) {
+                                    get_loop.Execute(nullptr, nullptr, n);
+                                }));
+
+    l.DoString(set_chunk);
+    auto set_loop = l.GetFunction("bench_loop");
+    results->push_back(RunBench("luaclass_property_set",
+                                "raw_userdata_field_set",
+                                [&set_loop](uint64_t n) {
+                                    set_loop.Execute(nullptr, nullptr, n);
+                                }));
+}
+
+static void BenchClassField(vector<BenchResult>* results) {
+    const char* get_chunk =
+        "function bench_loop(n) local v; for i = 1, n do v = p.x end end";
+    const char* set_chunk =
+        "function bench_loop(n) for i = 1, n do p.x = i end end";
+
+    LuaState l(NewCountingState(), true);
+    auto lclass = l.CreateClass<BenchPoint>("BenchPoint")
+                      .DefConstructor()
+                      .DefField<decltype(&BenchPoint::x), &BenchPoint::x>("x");
+    l.Set("p", lclass.CreateInstance());
+
+    l.DoString(get_chunk);
+    auto get_loop = l.GetFunction("bench_loop");
+    results->push_back(RunBench("luaclass_field_get", "raw_userdata_field_get",
+                                [&get_loop](uint64_t n) {
+                                    get_loop.Execute(nullptr, nullptr, n);
+                                }));
+
+    l.DoString(set_chunk);
+    auto set_loop = l.GetFunction("bench_loop");
+    results->push_back(RunBench("luaclass_field_set", "raw_userdata_field_set",
+                                [&set_loop](uint64_t n) {
+                                    set_loop.Execute(nullptr, nullptr, n);
+                                }));
+}
+
+/* ---------------------------- member functions ---------------------------- */
+
+static void BenchClassMemberFunction(vector<BenchResult>* results) {
+    const char* chunk =
+        "function bench_loop(n) local v; for i = 1, n do v = p:sum() end end";
+
+    lua_State* raw = NewRawPointState();
+    RunRawChunk(raw, chunk);
+    results->push_back(
+        RunBench("raw_userdata_method_call", nullptr, [raw](uint64_t n) {
+            RunRawLoop(raw, n);
+        }));
+    lua_close(raw);
+
+    LuaState l(NewCountingState(), true);
+    auto lclass = l.CreateClass<BenchPoint>("BenchPoint")
+                      .DefConstructor()
+                      .DefMember("sum", &BenchPoint::Sum);
+    l.Set("p", lclass.CreateInstance());
+
+    l.DoString(chunk);
+    auto loop = l.GetFunction("bench_loop");
+    results->push_back(RunBench("luaclass_member_function_call",
+                                "raw_userdata_method_call",
+                                [&loop](uint64_t n) {
+                                    loop.Execute(nullptr, nullptr, n);
+                                }));
+
+    LuaState ls(NewCountingState(), true);
+    auto lsclass =
+        ls.CreateClass<BenchPoint>("BenchPoint")
+            .DefConstructor()
+            .DefMember<decltype(&BenchPoint::Sum), &BenchPoint::Sum>("sum");
+    ls.Set("p", lsclass.CreateInstance());
+
+    ls.DoString(chunk);
+    auto static_loop = ls.GetFunction("bench_loop");
+    results->push_back(RunBench("luaclass_static_member_function_call",
+                                "raw_userdata_method_call",
+                                [&static_loop](uint64_t n) {
+                                    static_loop.Execute(nullptr, nullptr, n);
+                                }));
+}
+
+// calls a member function defined in the base class of a 3-level hierarchy
+static void BenchClassInheritedMemberFunction(vector<BenchResult>* results) {
+    LuaState l(NewCountingState(), true);
+    auto base = l.CreateClass<BenchBase>("BenchBase")
+                    .DefConstructor()
+                    .DefMember("get", &BenchBase::Get);
+    auto derived1 = l.CreateClass<BenchDerived1>("BenchDerived1")
+                        .AddBaseClass(base)
+                        .DefConstructor();
+    auto derived2 = l.CreateClass<BenchDerived2>("BenchDerived2")
+                        .AddBaseClass(derived1)
+                        .DefConstructor();
+    l.Set("b", base.CreateInstance());
+    l.Set("d", derived2.CreateInstance());
+
+    l.DoString(
+        "function bench_base(n) local v; for i = 1, n do v = b:get() end end;"
+        "function bench_derived(n) local v; for i = 1, n do v = d:get() end "
+        "end");
+
+    auto base_loop = l.GetFunction("bench_base");
+    results->push_back(RunBench("luaclass_member_function_call_level1",
+                                "raw_userdata_method_call",
+                                [&base_loop](uint64_t n) {
+                                    base_loop.Execute(nullptr, nullptr, n);
+                                }));
+
+    auto derived_loop = l.GetFunction("bench_derived");
+    results->push_back(RunBench("luaclass_member_function_call_level3",
+                                "raw_userdata_method_call",
+                                [&derived_loop](uint64_t n) {
+                                    derived_loop.Execute(nullptr, nullptr, n);
+                                }));
+}
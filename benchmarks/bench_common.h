@@ -0,0 +1,109 @@
+#ifndef __LUA_CPP_BENCH_COMMON_H__
+#define __LUA_CPP_BENCH_COMMON_H__
+
+extern "C" {
+#include "lua.h"
+#include "lauxlib.h"
+}
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <functional>
+using namespace std;
+
+struct BenchResult final {
+    string name;
+    string baseline; // empty if this is a baseline itself
+    uint64_t iterations;
+    double ns_per_call;
+    double allocs_per_call;
+};
+
+/* -------------------------------------------------------------------------- */
+
+// number of allocations made by c++ `operator new` and `lua_Alloc` of states
+// created by `NewCountingState()`
+extern uint64_t g_alloc_count;
+
+static void* CountingAlloc(void*, void* ptr, size_t osize, size_t nsize) {
+    if (nsize == 0) {
+        free(ptr);
+        return nullptr;
+    }
+    if (!ptr || nsize > osize) {
+        ++g_alloc_count;
+    }
+    return realloc(ptr, nsize);
+}
+
+static inline lua_State* NewCountingState() {
+    return lua_newstate(CountingAlloc, nullptr);
+}
+
+/* -------------------------------------------------------------------------- */
+
+/*
+  `run(n)` performs the operation being measured `n` times. iterations are
+  doubled until one round takes at least `BENCH_MIN_DURATION_NS`.
+*/
+static constexpr uint64_t BENCH_MIN_DURATION_NS = 50000000;
+static constexpr uint64_t BENCH_MAX_ITERATIONS = 1ull << 30;
+
+static BenchResult RunBench(const char* name, const char* baseline,
+                            const function<void(uint64_t n)>& run) {
+    run(100); // warm up
+
+    uint64_t n = 1000;
+    uint64_t allocs = 0;
+    uint64_t elapsed = 0;
+    while (true) {
+        allocs = g_alloc_count;
+        auto begin = chrono::steady_clock::now();
+        run(n);
+        auto end = chrono::steady_clock::now();
+        allocs = g_alloc_count - allocs;
+        elapsed =
+            chrono::duration_cast<chrono::nanoseconds>(end - begin).count();
+        if (elapsed >= BENCH_MIN_DURATION_NS || n >= BENCH_MAX_ITERATIONS) {
+            break;
+        }
+        n *= 2;
+    }
+
+    BenchResult res;
+    res.name = name;
+    if (baseline) {
+        res.baseline = baseline;
+    }
+    res.iterations = n;
+    res.ns_per_call = (double)elapsed / n;
+    res.allocs_per_call = (double)allocs / n;
+    return res;
+}
+
+/* -------------------------------------------------------------------------- */
+
+struct BenchPoint final {
+    int x = 10;
+    int y = 20;
+    int Sum() const {
+        return x + y;
+    }
+};
+
+struct BenchBase {
+    int value = 5;
+    int Get() const {
+        return value;
+    }
+};
+
+struct BenchDerived1 : public BenchBase {};
+
+struct BenchDerived2 : public BenchDerived1 {};
+
+#endif
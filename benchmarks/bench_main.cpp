@@ -0,0 +1,186 @@
+#include "bench_base.hpp"
+#include "bench_class.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <new>
+using namespace std;
+
+uint64_t g_alloc_count = 0;
+
+/*
+  replacements are not inlined, otherwise gcc sees `malloc()` and `free()`
+  paired with `operator new` and `operator delete` and warns about mismatched
+  pairs.
+*/
+#ifdef __GNUC__
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE void* operator new(size_t size) {
+    ++g_alloc_count;
+    auto ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw bad_alloc();
+    }
+    return ptr;
+}
+
+BENCH_NOINLINE void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+BENCH_NOINLINE void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+BENCH_NOINLINE void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+// default nothrow versions call the replaced ones above
+
+#ifdef __cpp_sized_deallocation
+BENCH_NOINLINE void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+BENCH_NOINLINE void operator delete[](void* ptr, size_t) noexcept {
+    free(ptr);
+}
+#endif
+
+#ifdef __cpp_aligned_new
+BENCH_NOINLINE void* operator new(size_t size, align_val_t alignment) {
+    ++g_alloc_count;
+    size_t align = (size_t)alignment;
+    if (align < sizeof(void*)) {
+        align = sizeof(void*);
+    }
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, align, size ? size : 1) != 0) {
+        throw bad_alloc();
+    }
+    return ptr;
+}
+
+BENCH_NOINLINE void* operator new[](size_t size, align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+BENCH_NOINLINE void operator delete(void* ptr, align_val_t) noexcept {
+    free(ptr);
+}
+
+BENCH_NOINLINE void operator delete[](void* ptr, align_val_t) noexcept {
+    free(ptr);
+}
+
+BENCH_NOINLINE void operator delete(void* ptr, size_t, align_val_t) noexcept {
+    free(ptr);
+}
+
+BENCH_NOINLINE void operator delete[](void* ptr, size_t, align_val_t) noexcept {
+    free(ptr);
+}
+#endif
+
+/* -------------------------------------------------------------------------- */
+
+#define BENCH_CASE(func) {#func, func}
+
+static const vector<pair<string, void (*)(vector<BenchResult>*)>>
+    g_bench_suite = {
+        // ----- bench base ----- //
+
+        BENCH_CASE(BenchCFunctionFromC),
+        BENCH_CASE(BenchCFunctionFromLua),
+        BENCH_CASE(BenchLuaFunctionFromC),
+        BENCH_CASE(BenchLuaFunctionBatch),
+        BENCH_CASE(BenchObjectScalar),
+        BENCH_CASE(BenchObjectCopy),
+        BENCH_CASE(BenchObjectScope),
+        BENCH_CASE(BenchTableForEach),
+        BENCH_CASE(BenchTableArgument),
+        BENCH_CASE(BenchTableArray),
+        BENCH_CASE(BenchTableKey),
+        BENCH_CASE(BenchTableCursor),
+        BENCH_CASE(BenchTablePath),
+        BENCH_CASE(BenchStateAllocator),
+        BENCH_CASE(BenchStateDisposable),
+        BENCH_CASE(BenchDoFileCache),
+        BENCH_CASE(BenchDoMapped),
+        BENCH_CASE(BenchDoStream),
+        BENCH_CASE(BenchDoStringCache),
+
+        // ----- bench class ----- //
+
+        BENCH_CASE(BenchClassProperty),
+        BENCH_CASE(BenchClassField),
+        BENCH_CASE(BenchClassMemberFunction),
+        BENCH_CASE(BenchClassInheritedMemberFunction),
+};
+
+static void WriteJson(FILE* fp, const vector<BenchResult>& results) {
+    fprintf(fp, "{\n  \"lua_version_num\": %d,\n  \"benchmarks\": [\n",
+            (int)LUA_VERSION_NUM);
+    for (size_t i = 0; i < results.size(); ++i) {
+        auto& res = results[i];
+        fprintf(fp,
+                "    {\"name\": \"%s\", \"iterations\": %llu, "
+                "\"ns_per_call\": %.3f, \"allocs_per_call\": %.3f",
+                res.name.c_str(), (unsigned long long)res.iterations,
+                res.ns_per_call, res.allocs_per_call);
+        if (!res.baseline.empty()) {
+            fprintf(fp, ", \"baseline\": \"%s\"", res.baseline.c_str());
+            for (auto& base : results) {
+                if (base.name == res.baseline && base.ns_per_call > 0) {
+                    fprintf(fp, ", \"ratio_to_baseline\": %.3f",
+                            res.ns_per_call / base.ns_per_call);
+                    break;
+                }
+            }
+        }
+        fprintf(fp, "}%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+/*
+  usage: luacpp_bench [filter] [output.json]
+
+  runs benchmarks whose names contain `filter`(all if omitted or empty) and
+  writes results as json to `output.json`(stdout if omitted).
+*/
+int main(int argc, char* argv[]) {
+    const char* filter = (argc > 1) ? argv[1] : "";
+    vector<BenchResult> results;
+
+    for (auto& x : g_bench_suite) {
+        if (x.first.find(filter) == string::npos) {
+            continue;
+        }
+        fprintf(stderr, "running %s ...\n", x.first.c_str());
+        x.second(&results);
+    }
+
+    FILE* fp = stdout;
+    if (argc > 2) {
+        fp = fopen(argv[2], "w");
+        if (!fp) {
+            fprintf(stderr, "cannot open `%s`: %s\n", argv[2],
+                    strerror(errno));
+            return -1;
+        }
+    }
+
+    WriteJson(fp, results);
+
+    if (fp != stdout) {
+        fclose(fp);
+    }
+    return 0;
+}
@@ -7,7 +7,11 @@ extern "C" {
 
 #include "lua_52_53.h"
 #include "lua_string_ref.h"
+#include "lua_stack_object.h"
+#include "lua_stack_table.h"
 #include <stdint.h>
+#include <string>
+#include <tuple>
 #include <functional>
 
 namespace luacpp {
@@ -16,6 +20,7 @@ class LuaRefObject;
 class LuaObject;
 class LuaTable;
 class LuaFunction;
+class LuaKey;
 
 template <typename T>
 class LuaClass;
@@ -24,6 +29,12 @@ class LuaClass;
 
 class ValueConverter final {
 private:
+    struct BoolConverter final {
+        bool Convert(lua_State* l, int idx) const {
+            return lua_toboolean(l, idx);
+        }
+    };
+
     template <typename T>
     struct IntegerConverter final {
         T Convert(lua_State* l, int idx) const {
@@ -58,19 +69,36 @@ public:
         return LuaStringRef(addr, len);
     }
 
+    operator std::string() const {
+        size_t len = 0;
+        auto addr = lua_tolstring(m_l, m_index, &len);
+        return addr ? std::string(addr, len) : std::string();
+    }
+
     operator LuaObject() const;
     operator LuaTable() const;
     operator LuaFunction() const;
 
+    // borrowed views without creating references
+    operator LuaStackObject() const {
+        return LuaStackObject(m_l, m_index);
+    }
+    operator LuaStackTable() const {
+        return LuaStackTable(m_l, m_index);
+    }
+
     template <typename T>
     operator T() const {
         typename std::conditional<
-            std::is_integral<T>::value, IntegerConverter<T>,
+            std::is_same<T, bool>::value, BoolConverter,
             typename std::conditional<
-                std::is_floating_point<T>::value, FloatConverter<T>,
-                typename std::conditional<std::is_pointer<T>::value,
-                                          PointerConverter<T>,
-                                          void>::type>::type>::type converter;
+                std::is_integral<T>::value, IntegerConverter<T>,
+                typename std::conditional<
+                    std::is_floating_point<T>::value, FloatConverter<T>,
+                    typename std::conditional<std::is_pointer<T>::value,
+                                              PointerConverter<T>,
+                                              void>::type>::type>::type>::type
+            converter;
         return converter.Convert(m_l, m_index);
     }
 
@@ -79,6 +107,69 @@ private:
     int m_index;
 };
 
+/*
+  converts values in [base, base + N) of the lua stack to the first N elements
+  of a tuple
+*/
+template <uint32_t N>
+struct TupleConverter final {
+    template <typename... T>
+    static void Convert(lua_State* l, int base, std::tuple<T...>* res) {
+        using ElementType =
+            typename std::tuple_element<N - 1, std::tuple<T...>>::type;
+        ElementType value = ValueConverter(l, base + N - 1);
+        std::get<N - 1>(*res) = std::move(value);
+        TupleConverter<N - 1>::Convert(l, base, res);
+    }
+};
+
+template <>
+struct TupleConverter<0> final {
+    template <typename... T>
+    static void Convert(lua_State*, int, std::tuple<T...>*) {}
+};
+
+// whether any of `T...` refers to values on the lua stack
+template <typename... T>
+struct HasBorrowedType;
+
+template <>
+struct HasBorrowedType<> final : public std::false_type {};
+
+template <typename First, typename... Rest>
+struct HasBorrowedType<First, Rest...> final
+    : public std::integral_constant<
+          bool,
+          std::is_same<First, const char*>::value ||
+              std::is_same<First, LuaStringRef>::value ||
+              std::is_same<First, LuaStackObject>::value ||
+              std::is_same<First, LuaStackTable>::value ||
+              HasBorrowedType<Rest...>::value> {};
+
+/*
+  calls `f(i, values...)` where `values` are N values in [base, base + N) of
+  the lua stack converted to argument types of `f`
+*/
+template <uint32_t N>
+struct ResultsApplier final {
+    template <typename FuncType, typename... Argv>
+    static bool Apply(FuncType& f, lua_State* l, int base, uint64_t i,
+                      Argv&&... argv) {
+        return ResultsApplier<N - 1>::Apply(f, l, base, i,
+                                            ValueConverter(l, base + N - 1),
+                                            std::forward<Argv>(argv)...);
+    }
+};
+
+template <>
+struct ResultsApplier<0> final {
+    template <typename FuncType, typename... Argv>
+    static bool Apply(FuncType& f, lua_State*, int, uint64_t i,
+                      Argv&&... argv) {
+        return f(i, std::forward<Argv>(argv)...);
+    }
+};
+
 /* -------------------------------------------------------------------------- */
 
 inline void PushValue(lua_State* l, const char* arg) {
@@ -89,16 +180,38 @@ inline void PushValue(lua_State* l, const LuaStringRef& arg) {
     lua_pushlstring(l, (const char*)arg.base, arg.size);
 }
 
+inline void PushValue(lua_State* l, const std::string& arg) {
+    lua_pushlstring(l, arg.data(), arg.size());
+}
+
+inline void PushValue(lua_State* l, const LuaStackObject& obj) {
+    lua_pushvalue(l, obj.GetIndex());
+}
+
+inline void PushValue(lua_State* l, const LuaStackTable& tbl) {
+    lua_pushvalue(l, tbl.GetIndex());
+}
+
+// message handler of `lua_pcall()` that appends a traceback to the message
+int TracebackMessageHandler(lua_State* l);
+
 void PushValue(lua_State* l, const LuaRefObject&);
 void PushValue(lua_State* l, const LuaObject&);
 void PushValue(lua_State* l, const LuaTable&);
 void PushValue(lua_State* l, const LuaFunction&);
+void PushValue(lua_State* l, const LuaKey&);
 
 template <typename T>
 void PushValue(lua_State* l, const LuaClass<T>& cls) {
-    lua_rawgeti(l, LUA_REGISTRYINDEX, cls.GetRefIndex());
+    cls.PushTo(l);
 }
 
+struct BoolPusher final {
+    BoolPusher(lua_State* l, bool value) {
+        lua_pushboolean(l, value);
+    }
+};
+
 template <typename T>
 struct IntegerPusher final {
     IntegerPusher(lua_State* l, T value) {
@@ -123,12 +236,14 @@ struct PointerPusher final {
 template <typename T>
 void PushValue(lua_State* l, T arg) {
     typename std::conditional<
-        std::is_integral<T>::value, IntegerPusher<T>,
+        std::is_same<T, bool>::value, BoolPusher,
         typename std::conditional<
-            std::is_floating_point<T>::value, FloatPusher<T>,
-            typename std::conditional<std::is_pointer<T>::value,
-                                      PointerPusher<T>, void>::type>::type>::
-        type pusher(l, arg);
+            std::is_integral<T>::value, IntegerPusher<T>,
+            typename std::conditional<
+                std::is_floating_point<T>::value, FloatPusher<T>,
+                typename std::conditional<std::is_pointer<T>::value,
+                                          PointerPusher<T>, void>::type>::
+                type>::type>::type pusher(l, arg);
 }
 
 inline void PushValues(lua_State*) {}
@@ -139,6 +254,48 @@ void PushValues(lua_State* l, First&& first, Rest&&... rest) {
     PushValues(l, std::forward<Rest>(rest)...);
 }
 
+template <uint32_t N>
+struct TuplePusher final {
+    template <typename... T>
+    static void Push(lua_State* l, const std::tuple<T...>& values) {
+        TuplePusher<N - 1>::Push(l, values);
+        PushValue(l, std::get<N - 1>(values));
+    }
+};
+
+template <>
+struct TuplePusher<0> final {
+    template <typename... T>
+    static void Push(lua_State*, const std::tuple<T...>&) {}
+};
+
+template <typename T>
+struct IsTuple final : public std::false_type {};
+
+template <typename... T>
+struct IsTuple<std::tuple<T...>> final : public std::true_type {};
+
+// pushes `value`, or all elements of `value` if it is a `std::tuple`, and
+// returns the number of values pushed
+template <typename T>
+int PushArguments(lua_State* l, T&& value, std::false_type /* is tuple */) {
+    PushValue(l, std::forward<T>(value));
+    return 1;
+}
+
+template <typename T>
+int PushArguments(lua_State* l, T&& value, std::true_type /* is tuple */) {
+    using TupleType = typename std::decay<T>::type;
+    TuplePusher<std::tuple_size<TupleType>::value>::Push(l, value);
+    return std::tuple_size<TupleType>::value;
+}
+
+template <typename T>
+int PushArguments(lua_State* l, T&& value) {
+    return PushArguments(l, std::forward<T>(value),
+                         IsTuple<typename std::decay<T>::type>());
+}
+
 /* -------------------------------------------------------------------------- */
 
 template <typename T>
@@ -148,7 +305,12 @@ template <typename FuncRetType, typename... FuncArgType>
 struct FunctionTraits<FuncRetType(FuncArgType...)> {
     using return_type = FuncRetType;
     using std_function_type = std::function<FuncRetType(FuncArgType...)>;
+    using pointer_type = FuncRetType (*)(FuncArgType...);
     static constexpr uint32_t argc = sizeof...(FuncArgType);
+
+    template <uint32_t N>
+    using arg_type =
+        typename std::tuple_element<N, std::tuple<FuncArgType...>>::type;
 };
 
 template <typename FuncRetType, typename... FuncArgType>
@@ -177,6 +339,35 @@ template <typename ClassType>
 struct FunctionTraits final
     : public FunctionTraits<decltype(&ClassType::operator())> {};
 
+/*
+  type used to store a callable `FuncType`. captureless lambda functions are
+  converted to function pointers, and others are stored as they are.
+*/
+template <typename FuncType, bool is_class = std::is_class<FuncType>::value>
+struct CallableStorage final {
+    using type = FuncType;
+};
+
+template <typename FuncType>
+struct CallableStorage<FuncType, true> final {
+private:
+    using pointer_type = typename FunctionTraits<FuncType>::pointer_type;
+
+public:
+    using type = typename std::conditional<
+        std::is_convertible<FuncType, pointer_type>::value, pointer_type,
+        FuncType>::type;
+};
+
+template <typename FuncType>
+using CallableStorageType =
+    typename CallableStorage<typename std::decay<FuncType>::type>::type;
+
+// whether `FuncType` should be exported as a lua-style function directly
+template <typename FuncType>
+using IsLuaCFunction =
+    std::is_same<CallableStorageType<FuncType>, int (*)(lua_State*)>;
+
 /* -------------------------------------------------------------------------- */
 
 template <typename FuncType, typename... Argv>
@@ -275,7 +466,8 @@ int luacpp_generic_destructor(lua_State* l) {
     return 0;
 }
 
-// FuncType may be a c-style function or a std::function or a callable object
+// FuncType may be a c-style function, a class member function, a std::function
+// or a callable object
 template <typename FuncType>
 int luacpp_generic_function(lua_State* l) {
     auto argoffset = lua_tointeger(l, lua_upvalueindex(1));
@@ -285,34 +477,146 @@ int luacpp_generic_function(lua_State* l) {
         wrapper->f, l, argoffset);
 }
 
-// pushes an instance of `luacpp_generic_function`
+// pushes an instance of `luacpp_generic_function`. `f` is stored as
+// `CallableStorageType<FuncType>`.
 template <typename FuncType>
 void CreateGenericFunction(lua_State* l, int gc_table_ref, int argoffset,
                            FuncType&& f) {
-    using WrapperType = FuncWrapper<FuncType>;
+    using StorageType = CallableStorageType<FuncType>;
+    using WrapperType = FuncWrapper<StorageType>;
 
     // upvalue 1: argoffset
     lua_pushinteger(l, argoffset);
 
     // upvalue 2: wrapper
     auto wrapper = lua_newuserdatauv(l, sizeof(WrapperType), 0);
-    new (wrapper) WrapperType(std::forward<FuncType>(f));
+    new (wrapper) WrapperType(StorageType(std::forward<FuncType>(f)));
 
-    // wrapper's destructor
-    lua_rawgeti(l, LUA_REGISTRYINDEX, gc_table_ref);
-    lua_setmetatable(l, -2);
+    // wrapper's destructor. function pointers and trivially destructible
+    // callable objects need nothing to do.
+    if (!std::is_trivially_destructible<StorageType>::value) {
+        lua_rawgeti(l, LUA_REGISTRYINDEX, gc_table_ref);
+        lua_setmetatable(l, -2);
+    }
+
+    lua_pushcclosure(l, luacpp_generic_function<StorageType>, 2);
+}
+
+// calls `f` known at compile time without any upvalue
+template <typename FuncType, FuncType f, int argoffset>
+int luacpp_static_function(lua_State* l) {
+    return FunctionCaller<FunctionTraits<FuncType>::argc>::Execute(f, l,
+                                                                   argoffset);
+}
+
+// returns a lua-style function calling `f`, or `f` itself if it is already a
+// lua-style function
+template <typename FuncType, FuncType f, int argoffset>
+lua_CFunction GetStaticFunction(std::false_type /* is lua-style */) {
+    return luacpp_static_function<FuncType, f, argoffset>;
+}
 
-    lua_pushcclosure(l, luacpp_generic_function<FuncType>, 2);
+template <typename FuncType, FuncType f, int argoffset>
+lua_CFunction GetStaticFunction(std::true_type /* is lua-style */) {
+    return f;
 }
 
+template <typename FuncType, FuncType f, int argoffset>
+lua_CFunction GetStaticFunction() {
+    return GetStaticFunction<FuncType, f, argoffset>(
+        IsLuaCFunction<FuncType>());
+}
+
+/* -------------------------------------------------------------------------- */
+
 template <typename T>
-void BuiltInTypeAssert() {
-    static_assert(std::is_same<T, LuaRefObject>::value ||
-                      std::is_same<T, LuaObject>::value ||
-                      std::is_same<T, LuaTable>::value ||
-                      std::is_same<T, LuaFunction>::value ||
-                      std::is_same<T, LuaStringRef>::value,
-                  "is not a luacpp builtin type");
+struct IsBuiltInType final
+    : public std::integral_constant<
+          bool,
+          std::is_same<T, LuaRefObject>::value ||
+              std::is_same<T, LuaObject>::value ||
+              std::is_same<T, LuaTable>::value ||
+              std::is_same<T, LuaFunction>::value ||
+              std::is_same<T, LuaStringRef>::value> {};
+
+template <typename T>
+T ConvertStackValue(lua_State* l, int idx, std::true_type /* is builtin */) {
+    return T(l, idx);
+}
+
+template <typename T>
+T ConvertStackValue(lua_State* l, int idx, std::false_type /* is builtin */) {
+    T value = ValueConverter(l, idx);
+    return value;
+}
+
+// converts the value at `idx` to `T`, which can be builtin types or any type
+// that arguments of exported functions can be
+template <typename T>
+T ConvertStackValue(lua_State* l, int idx) {
+    return ConvertStackValue<T>(l, idx, IsBuiltInType<T>());
+}
+
+template <typename FuncType>
+bool IterateTable(lua_State* l, int idx, FuncType& f,
+                  std::true_type /* is array */) {
+    using ValueType = typename std::decay<typename FunctionTraits<
+        typename std::decay<FuncType>::type>::template arg_type<1>>::type;
+
+    auto len = lua_rawlen(l, idx);
+    for (uint32_t i = 0; i < len; ++i) {
+        lua_rawgeti(l, idx, i + 1);
+        bool go_on = f(i, ConvertStackValue<ValueType>(l, -1));
+        lua_pop(l, 1);
+        if (!go_on) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename FuncType>
+bool IterateTable(lua_State* l, int idx, FuncType& f,
+                  std::false_type /* is array */) {
+    using Traits = FunctionTraits<typename std::decay<FuncType>::type>;
+    using KeyType =
+        typename std::decay<typename Traits::template arg_type<0>>::type;
+    using ValueType =
+        typename std::decay<typename Traits::template arg_type<1>>::type;
+
+    lua_pushnil(l);
+    while (lua_next(l, idx) != 0) {
+        // converts a copy of the key because converting a number to a string
+        // changes the key in place and confuses `lua_next()`
+        lua_pushvalue(l, -2);
+        bool go_on = f(ConvertStackValue<KeyType>(l, -1),
+                       ConvertStackValue<ValueType>(l, -2));
+        lua_pop(l, 2);
+        if (!go_on) {
+            lua_pop(l, 1); // the key
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+  iterates the table at `idx` with `f`, which is one of the following:
+    - (uint32_t i, ValueType value) -> bool, iterating the array part. `i`
+      starts from 0.
+    - (KeyType key, ValueType value) -> bool, iterating all key-value pairs.
+*/
+template <typename FuncType>
+bool IterateTable(lua_State* l, int idx, FuncType& f) {
+    using Traits = FunctionTraits<typename std::decay<FuncType>::type>;
+    static_assert(Traits::argc == 2, "callback should have 2 arguments");
+    return IterateTable(
+        l, lua_absindex(l, idx), f,
+        std::is_same<typename std::decay<
+                         typename Traits::template arg_type<0>>::type,
+                     uint32_t>());
 }
 
 }
@@ -3,6 +3,24 @@
 
 // some Lua 5.4 APIs for 5.2 and 5.3
 
+#if LUA_VERSION_NUM == 502
+
+namespace luacpp {
+
+// all numbers are floating point numbers in 5.2
+inline int lua_isinteger(lua_State*, int) {
+    return 0;
+}
+
+// `strip` is not supported in 5.2
+inline int lua_dump(lua_State* l, lua_Writer writer, void* data, int) {
+    return ::lua_dump(l, writer, data);
+}
+
+}
+
+#endif
+
 #if LUA_VERSION_NUM >= 502 && LUA_VERSION_NUM < 504
 
 namespace luacpp {
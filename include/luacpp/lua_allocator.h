@@ -0,0 +1,30 @@
+#ifndef __LUA_CPP_LUA_ALLOCATOR_H__
+#define __LUA_CPP_LUA_ALLOCATOR_H__
+
+extern "C" {
+#include "lua.h"
+}
+
+namespace luacpp {
+
+/*
+  base class of allocators owned by `LuaState`. `GetAllocFunc()` is passed to
+  `lua_newstate()` with the allocator itself as `ud`, and the allocator is
+  destroyed after the state is closed.
+*/
+class LuaAllocator {
+public:
+    LuaAllocator(lua_Alloc f) : m_alloc_func(f) {}
+    virtual ~LuaAllocator() {}
+
+    lua_Alloc GetAllocFunc() const {
+        return m_alloc_func;
+    }
+
+private:
+    lua_Alloc m_alloc_func;
+};
+
+}
+
+#endif
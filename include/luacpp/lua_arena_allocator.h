@@ -0,0 +1,66 @@
+#ifndef __LUA_CPP_LUA_ARENA_ALLOCATOR_H__
+#define __LUA_CPP_LUA_ARENA_ALLOCATOR_H__
+
+#include "lua_allocator.h"
+#include <stdint.h>
+#include <stddef.h>
+
+namespace luacpp {
+
+/*
+  A bump allocator for short-lived states. Small blocks are carved from a
+  chain of chunks, each twice as large as the previous one, and freeing them
+  does nothing. Large blocks are allocated by `malloc()` and freed as usual.
+  All chunks are released at once when the allocator is destroyed, so memory
+  freed by lua is not reused until then.
+*/
+class LuaArenaAllocator final : public LuaAllocator {
+public:
+    struct Stats final {
+        uint64_t chunk_num;
+        uint64_t chunk_bytes; // bytes of all chunks
+        uint64_t used_bytes; // bytes carved from chunks, including freed ones
+        uint64_t large_blocks;
+        uint64_t large_bytes;
+    };
+
+public:
+    // `chunk_size` is the size of the first chunk
+    LuaArenaAllocator(size_t chunk_size);
+    ~LuaArenaAllocator();
+
+    LuaArenaAllocator(const LuaArenaAllocator&) = delete;
+    LuaArenaAllocator& operator=(const LuaArenaAllocator&) = delete;
+
+    void GetStats(Stats*) const;
+
+private:
+    static void* Alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+    void* AllocSmall(size_t size);
+    void* AllocLarge(size_t size);
+    bool AddChunk(size_t min_size);
+    void* KeepLarge(void* ptr, size_t osize, size_t nsize);
+    void* Realloc(void* ptr, size_t osize, size_t nsize);
+
+private:
+    // chunks are linked by headers in front of their free space
+    struct ChunkHeader final {
+        ChunkHeader* next;
+    };
+
+    ChunkHeader* m_chunks; // the latest chunk
+    uint64_t m_chunk_num;
+    size_t m_next_chunk_size;
+    char* m_cur; // free space of the last chunk
+    char* m_end;
+    char* m_last_block; // the latest block carved, which can grow in place
+    uint64_t m_chunk_bytes;
+    uint64_t m_used_bytes;
+    uint64_t m_large_blocks;
+    uint64_t m_large_bytes;
+};
+
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef __LUA_CPP_LUA_BYTECODE_CACHE_H__
+#define __LUA_CPP_LUA_BYTECODE_CACHE_H__
+
+extern "C" {
+#include "lua.h"
+}
+
+#include <stdint.h>
+#include <string>
+
+namespace luacpp {
+
+/*
+  returns false if `dir` is not a directory, or, on POSIX systems, is not
+  owned by the current user or is writable by others, since bytecode is not
+  verified by lua.
+*/
+bool CheckBytecodeCacheDir(const char* dir, std::string* errstr);
+
+/*
+  loads `script` like `luaL_loadfile()`, using the compiled chunk saved in
+  `cache_dir` if it is up to date. the cache file is keyed by the path of
+  `script`, and is valid only if the size, modification time and content hash
+  of `script` are the same as those when it was saved. the content is read
+  and hashed only if the size and modification time match. otherwise `script`
+  is compiled and saved to `cache_dir` again. errors of the cache are ignored,
+  and cache files saved in other formats, e.g. by an older version using
+  another hash function, are treated as corrupt.
+*/
+int LoadFileWithBytecodeCache(lua_State* l, const char* script,
+                              const char* cache_dir);
+
+/*
+  skips the UTF-8 BOM and the first line if it starts with '#' like
+  `luaL_loadfile()`. the newline is kept for source code so that line numbers
+  are not changed.
+*/
+const char* SkipComment(const char* data, uint64_t* len);
+
+}
+
+#endif
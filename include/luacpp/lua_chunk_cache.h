@@ -0,0 +1,73 @@
+#ifndef __LUA_CPP_LUA_CHUNK_CACHE_H__
+#define __LUA_CPP_LUA_CHUNK_CACHE_H__
+
+extern "C" {
+#include "lua.h"
+}
+
+#include <stdint.h>
+#include <string>
+#include <list>
+#include <unordered_map>
+
+namespace luacpp {
+
+/*
+  A LRU cache of functions compiled from chunks, which are kept in the
+  registry. chunks are looked up by their content hashes and compared to
+  cached ones before being used.
+*/
+class LuaChunkCache final {
+public:
+    struct Stats final {
+        uint64_t hits;
+        uint64_t misses;
+        uint32_t size; // number of cached chunks
+        uint32_t capacity;
+    };
+
+public:
+    LuaChunkCache() : m_capacity(0), m_hits(0), m_misses(0) {}
+
+    LuaChunkCache(LuaChunkCache&&) = default;
+    LuaChunkCache& operator=(LuaChunkCache&&) = default;
+
+    uint32_t GetCapacity() const {
+        return m_capacity;
+    }
+
+    // least recently used chunks are released if there are more than `cap`
+    void SetCapacity(lua_State* l, uint32_t cap);
+
+    /*
+      pushes the function compiled from `chunk`, which is loaded by
+      `luaL_loadstring()` if it is not cached. returns the result of
+      `luaL_loadstring()`, and the error message is pushed on failure.
+    */
+    int Load(lua_State* l, const char* chunk);
+
+    // releases all cached chunks
+    void Clear(lua_State* l);
+
+    void GetStats(Stats*) const;
+
+private:
+    struct Entry final {
+        uint64_t hash;
+        std::string chunk;
+        int ref; // index of the function in the registry
+    };
+
+    void RemoveLast(lua_State* l);
+
+private:
+    uint32_t m_capacity;
+    uint64_t m_hits;
+    uint64_t m_misses;
+    std::list<Entry> m_entries; // most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> m_index;
+};
+
+}
+
+#endif
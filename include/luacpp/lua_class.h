@@ -10,16 +10,214 @@ namespace luacpp {
 
 static constexpr uint32_t CLASS_PARENT_TABLE_IDX = 1;
 static constexpr uint32_t CLASS_INSTANCE_METATABLE_IDX = 2;
-
-static constexpr uint32_t MEMBER_GETTER_IDX = 1;
-static constexpr uint32_t MEMBER_SETTER_IDX = 2;
+static constexpr uint32_t CLASS_LOOKUP_TABLE_IDX = 3;
+static constexpr uint32_t CLASS_CHILDREN_TABLE_IDX = 4;
+static constexpr uint32_t CLASS_USERVALUE_NUM = 4;
 
 struct LuaClassData final {
     // a metatable including only __gc function for various objects such as
     // `FuncWrapper`
     int gc_table_ref = LUA_REFNIL;
+
+    // metatable of properties, which is checked before accessing properties
+    int property_metatable_ref = LUA_REFNIL;
+
+    // whether the lookup table needs to be rebuilt before being used
+    bool lookup_table_outdated = true;
+};
+
+/*
+  The lookup table of a class flattens all members that can be accessed by its
+  instances, including member functions, properties and static members of this
+  class and all its base classes, so that finding a member of an instance only
+  needs one raw get regardless of the depth of inheritance.
+*/
+
+// marks lookup tables of the class at `idx` and all its derived classes as
+// outdated. should be called whenever members or base classes are changed.
+void InvalidateClassLookupTable(lua_State* l, int idx);
+
+// pushes the lookup table of the class at `idx`, rebuilding it if outdated.
+void PushClassLookupTable(lua_State* l, int idx);
+
+/* -------------------------------------------------------------------------- */
+
+/*
+  Properties are stored as userdata of `PropertyWrapperBase`s, whose
+  accessors are invoked directly by `__index` and `__newindex` of classes and
+  instances without calling any intermediate lua functions. `get` or `set` is
+  nullptr if the property is not readable or writable.
+*/
+struct PropertyWrapperBase : public DestructorObject {
+    // pushes the value of the property of the object at `obj_idx`
+    void (*get)(lua_State* l, PropertyWrapperBase*, int obj_idx) = nullptr;
+    // sets the property of the object at `obj_idx` to the value at `value_idx`
+    void (*set)(lua_State* l, PropertyWrapperBase*, int obj_idx,
+                int value_idx) = nullptr;
+};
+
+template <typename F>
+bool IsNullAccessor(const F&) {
+    return false;
+}
+
+template <typename R, typename... Argv>
+bool IsNullAccessor(R (*f)(Argv...)) {
+    return !f;
+}
+
+template <typename R, typename... Argv>
+bool IsNullAccessor(const std::function<R(Argv...)>& f) {
+    return !f;
+}
+
+/*
+  accessors are stored as they are except that `nullptr` is stored as a null
+  function pointer and member function pointers are wrapped in
+  `std::function`s.
+*/
+template <typename AccessorType, typename FuncPtrType, typename StdFuncType>
+using PropertyAccessorStorage = typename std::conditional<
+    std::is_same<typename std::decay<AccessorType>::type,
+                 std::nullptr_t>::value,
+    FuncPtrType,
+    typename std::conditional<
+        std::is_member_function_pointer<
+            typename std::decay<AccessorType>::type>::value,
+        StdFuncType, typename std::decay<AccessorType>::type>::type>::type;
+
+/*
+  member property
+    - GetterType: (const T*) -> PropertyType
+    - SetterType: (T*, PropertyType) -> void
+*/
+template <typename T, typename PropertyType, typename GetterType,
+          typename SetterType>
+struct MemberPropertyWrapper final : public PropertyWrapperBase {
+    using GetterStorage =
+        PropertyAccessorStorage<GetterType, PropertyType (*)(const T*),
+                                std::function<PropertyType(const T*)>>;
+    using SetterStorage =
+        PropertyAccessorStorage<SetterType, void (*)(T*, PropertyType),
+                                std::function<void(T*, PropertyType)>>;
+
+    MemberPropertyWrapper(GetterType&& g, SetterType&& s)
+        : getter(std::forward<GetterType>(g))
+        , setter(std::forward<SetterType>(s)) {
+        if (!IsNullAccessor(getter)) {
+            get = Get;
+        }
+        if (!IsNullAccessor(setter)) {
+            set = Set;
+        }
+    }
+
+    static void Get(lua_State* l, PropertyWrapperBase* base, int obj_idx) {
+        auto self = static_cast<MemberPropertyWrapper*>(base);
+        auto obj = (const T*)lua_touserdata(l, obj_idx);
+        PushValue(l, static_cast<PropertyType>(self->getter(obj)));
+    }
+
+    static void Set(lua_State* l, PropertyWrapperBase* base, int obj_idx,
+                    int value_idx) {
+        auto self = static_cast<MemberPropertyWrapper*>(base);
+        auto obj = (T*)lua_touserdata(l, obj_idx);
+        PropertyType value = ValueConverter(l, value_idx);
+        self->setter(obj, std::forward<PropertyType>(value));
+    }
+
+    GetterStorage getter;
+    SetterStorage setter;
 };
 
+/*
+  static property
+    - GetterType: () -> PropertyType
+    - SetterType: (PropertyType) -> void
+*/
+template <typename PropertyType, typename GetterType, typename SetterType>
+struct StaticPropertyWrapper final : public PropertyWrapperBase {
+    using GetterStorage =
+        PropertyAccessorStorage<GetterType, PropertyType (*)(void),
+                                std::function<PropertyType(void)>>;
+    using SetterStorage =
+        PropertyAccessorStorage<SetterType, void (*)(PropertyType),
+                                std::function<void(PropertyType)>>;
+
+    StaticPropertyWrapper(GetterType&& g, SetterType&& s)
+        : getter(std::forward<GetterType>(g))
+        , setter(std::forward<SetterType>(s)) {
+        if (!IsNullAccessor(getter)) {
+            get = Get;
+        }
+        if (!IsNullAccessor(setter)) {
+            set = Set;
+        }
+    }
+
+    static void Get(lua_State* l, PropertyWrapperBase* base, int) {
+        auto self = static_cast<StaticPropertyWrapper*>(base);
+        PushValue(l, static_cast<PropertyType>(self->getter()));
+    }
+
+    static void Set(lua_State* l, PropertyWrapperBase* base, int,
+                    int value_idx) {
+        auto self = static_cast<StaticPropertyWrapper*>(base);
+        PropertyType value = ValueConverter(l, value_idx);
+        self->setter(std::forward<PropertyType>(value));
+    }
+
+    GetterStorage getter;
+    SetterStorage setter;
+};
+
+template <typename MemberPtrType>
+struct MemberObjectTraits;
+
+template <typename ClassType, typename FieldType>
+struct MemberObjectTraits<FieldType ClassType::*> final {
+    using class_type = ClassType;
+    using value_type = FieldType;
+};
+
+/*
+  member field `field` of class `T`, which is accessed at a fixed offset by
+  accessors generated at compile time. The wrapper only holds pointers to
+  accessors.
+*/
+template <typename T, typename MemberPtrType, MemberPtrType field,
+          bool readonly>
+struct FieldPropertyWrapper final : public PropertyWrapperBase {
+    using FieldType = typename MemberObjectTraits<MemberPtrType>::value_type;
+
+    FieldPropertyWrapper() {
+        get = Get;
+        set = GetSetter(std::integral_constant<bool, readonly>());
+    }
+
+private:
+    static void Get(lua_State* l, PropertyWrapperBase*, int obj_idx) {
+        auto obj = (const T*)lua_touserdata(l, obj_idx);
+        PushValue(l, obj->*field);
+    }
+
+    static void Set(lua_State* l, PropertyWrapperBase*, int obj_idx,
+                    int value_idx) {
+        auto obj = (T*)lua_touserdata(l, obj_idx);
+        FieldType value = ValueConverter(l, value_idx);
+        obj->*field = value;
+    }
+
+    static decltype(PropertyWrapperBase::set) GetSetter(std::true_type) {
+        return nullptr;
+    }
+    static decltype(PropertyWrapperBase::set) GetSetter(std::false_type) {
+        return Set;
+    }
+};
+
+/* -------------------------------------------------------------------------- */
+
 template <typename T>
 class LuaClass final : public LuaRefObject {
 private:
@@ -34,6 +232,14 @@ private:
         lua_remove(m_l, -2);
     }
 
+    void InvalidateLookupTable() {
+        if (!m_data->lookup_table_outdated) {
+            PushSelf();
+            InvalidateClassLookupTable(m_l, -1);
+            lua_pop(m_l, 1);
+        }
+    }
+
     void Init() {
         PushSelf();
         m_data = (LuaClassData*)lua_touserdata(m_l, -1);
@@ -82,18 +288,28 @@ private:
                               std::forward<FuncType>(f));
         lua_setfield(l, -2, name);
         lua_pop(l, 2);
+        InvalidateLookupTable();
+    }
+
+    template <typename FuncType>
+    LuaClass& DoDefStaticImpl(const char* name, FuncType&& f,
+                              std::true_type /* is lua-style */) {
+        return DoDefStatic(
+            name, static_cast<int (*)(lua_State*)>(std::forward<FuncType>(f)));
+    }
+
+    template <typename FuncType>
+    LuaClass& DoDefStaticImpl(const char* name, FuncType&& f,
+                              std::false_type /* is lua-style */) {
+        DoDefStaticFunction(m_l, name, std::forward<FuncType>(f));
+        return *this;
     }
 
     // c-style functions, `std::function`s and lambda functions
     template <typename FuncType>
     LuaClass& DoDefStatic(const char* name, FuncType&& f) {
-        using RealFuncType = typename std::remove_reference<FuncType>::type;
-        using ConvertedFuncType = typename std::conditional<
-            std::is_pointer<RealFuncType>::value, RealFuncType,
-            typename FunctionTraits<RealFuncType>::std_function_type>::type;
-        ConvertedFuncType func(std::forward<FuncType>(f));
-        DoDefStaticFunction(m_l, name, std::move(func));
-        return *this;
+        return DoDefStaticImpl(name, std::forward<FuncType>(f),
+                               IsLuaCFunction<FuncType>());
     }
 
     // lua-style functions that can be used to implement variadic argument
@@ -104,6 +320,7 @@ private:
         lua_pushcfunction(m_l, f);
         lua_setfield(m_l, -2, name);
         lua_pop(m_l, 2);
+        InvalidateLookupTable();
         return *this;
     }
 
@@ -117,22 +334,33 @@ private:
                               std::forward<FuncType>(f));
         lua_setfield(l, -2, name);
         lua_pop(l, 1);
+        InvalidateLookupTable();
+    }
+
+    template <typename FuncType>
+    LuaClass& DoDefMemberImpl(const char* name, FuncType&& f,
+                              std::true_type /* is lua-style */) {
+        return DoDefMember(
+            name, static_cast<int (*)(lua_State*)>(std::forward<FuncType>(f)));
+    }
+
+    template <typename FuncType>
+    LuaClass& DoDefMemberImpl(const char* name, FuncType&& f,
+                              std::false_type /* is lua-style */) {
+        constexpr int argoffset = (std::is_member_function_pointer<
+                                       CallableStorageType<FuncType>>::value
+                                       ? 1
+                                       : 0);
+        DoDefMemberFunction(m_l, argoffset, name, std::forward<FuncType>(f));
+        return *this;
     }
 
     // class member functions, c-style functions, `std::function`s and lambda
     // functions
     template <typename FuncType>
     LuaClass& DoDefMember(const char* name, FuncType&& f) {
-        constexpr int argoffset =
-            (std::is_member_function_pointer<FuncType>::value ? 1 : 0);
-        using ConvertedFuncType = typename std::conditional<
-            (std::is_member_function_pointer<FuncType>::value ||
-             std::is_pointer<FuncType>::value),
-            FuncType,
-            typename FunctionTraits<FuncType>::std_function_type>::type;
-        ConvertedFuncType func(std::forward<FuncType>(f));
-        DoDefMemberFunction(m_l, argoffset, name, std::move(func));
-        return *this;
+        return DoDefMemberImpl(name, std::forward<FuncType>(f),
+                               IsLuaCFunction<FuncType>());
     }
 
     // lua-style functions that can be used to implement variadic argument
@@ -142,49 +370,58 @@ private:
         lua_pushcfunction(m_l, f);
         lua_setfield(m_l, -2, name);
         lua_pop(m_l, 1);
+        InvalidateLookupTable();
         return *this;
     }
 
-    /* -------------------- member properties ------------------------------- */
+    /* ------------------------------ properties ---------------------------- */
 
-    template <typename GetterType, typename SetterType>
-    void CreateMemberProperty(lua_State* l, GetterType&& getter,
-                              SetterType&& setter) {
-        lua_createtable(l, 2, 0);
-        if (getter) {
-            CreateGenericFunction(l, m_data->gc_table_ref, 0,
-                                  std::forward<GetterType>(getter));
-            lua_rawseti(l, -2, MEMBER_GETTER_IDX);
-        }
-        if (setter) {
-            CreateGenericFunction(l, m_data->gc_table_ref, 0,
+    // pushes a userdata of `WrapperType`
+    template <typename WrapperType, typename GetterType, typename SetterType>
+    void CreateProperty(lua_State* l, GetterType&& getter,
+                        SetterType&& setter) {
+        auto wrapper = lua_newuserdatauv(l, sizeof(WrapperType), 0);
+        new (wrapper) WrapperType(std::forward<GetterType>(getter),
                                   std::forward<SetterType>(setter));
-            lua_rawseti(l, -2, MEMBER_SETTER_IDX);
-        }
+
+        // wrapper's destructor, which also marks it as a property
+        lua_rawgeti(l, LUA_REGISTRYINDEX, m_data->property_metatable_ref);
+        lua_setmetatable(l, -2);
     }
 
-    /* --------------------- static properties ------------------------------ */
+    template <typename MemberPtrType, MemberPtrType field, bool readonly>
+    LuaClass& DoDefField(const char* name) {
+        static_assert(std::is_member_object_pointer<MemberPtrType>::value,
+                      "`field` is not a pointer to data member");
+        static_assert(std::is_base_of<typename MemberObjectTraits<
+                                          MemberPtrType>::class_type,
+                                      T>::value,
+                      "`field` is not a member of this class");
+
+        using WrapperType =
+            FieldPropertyWrapper<T, MemberPtrType, field, readonly>;
+
+        /*
+          a full userdata rather than a light one, which has no metatable to
+          tell it from other light userdata.
+        */
+        PushInstanceMetatable();
+        auto wrapper = lua_newuserdatauv(m_l, sizeof(WrapperType), 0);
+        new (wrapper) WrapperType();
+        lua_rawgeti(m_l, LUA_REGISTRYINDEX, m_data->property_metatable_ref);
+        lua_setmetatable(m_l, -2);
+        lua_setfield(m_l, -2, name);
+        lua_pop(m_l, 1);
+        InvalidateLookupTable();
 
-    template <typename GetterType, typename SetterType>
-    void CreateStaticProperty(lua_State* l, GetterType&& getter,
-                              SetterType&& setter) {
-        lua_createtable(l, 2, 0);
-        if (getter) {
-            CreateGenericFunction(l, m_data->gc_table_ref, 1,
-                                  std::forward<GetterType>(getter));
-            lua_rawseti(l, -2, MEMBER_GETTER_IDX);
-        }
-        if (setter) {
-            CreateGenericFunction(l, m_data->gc_table_ref, 1,
-                                  std::forward<SetterType>(setter));
-            lua_rawseti(l, -2, MEMBER_SETTER_IDX);
-        }
+        return *this;
     }
 
     /* ---------------------------------------------------------------------- */
 
 public:
-    LuaClass(lua_State* l, int index) : LuaRefObject(l, index) {
+    LuaClass(lua_State* l, int index, LuaScope* scope = nullptr)
+        : LuaRefObject(l, index, scope) {
         Init();
     }
     LuaClass(LuaObject&& rhs) : LuaRefObject(std::move(rhs)) {
@@ -224,16 +461,15 @@ public:
     template <typename PropertyType, typename GetterType, typename SetterType>
     LuaClass& DefMember(const char* name, GetterType&& getter,
                         SetterType&& setter) {
-        std::function<PropertyType(const T*)> getter_func(
-            std::forward<GetterType>(getter));
-        std::function<void(T*, PropertyType)> setter_func(
-            std::forward<SetterType>(setter));
+        using WrapperType =
+            MemberPropertyWrapper<T, PropertyType, GetterType, SetterType>;
 
         PushInstanceMetatable();
-        CreateMemberProperty(m_l, std::move(getter_func),
-                             std::move(setter_func));
+        CreateProperty<WrapperType>(m_l, std::forward<GetterType>(getter),
+                                    std::forward<SetterType>(setter));
         lua_setfield(m_l, -2, name);
         lua_pop(m_l, 1);
+        InvalidateLookupTable();
 
         return *this;
     }
@@ -243,6 +479,56 @@ public:
         return DoDefMember(name, std::forward<FuncType>(f));
     }
 
+    /*
+      member function `f` known at compile time, e.g.
+      `DefMember<decltype(&Point::Sum), &Point::Sum>("sum")`. The exported
+      function has no upvalue.
+    */
+    template <typename FuncType, FuncType f>
+    LuaClass& DefMember(const char* name) {
+        constexpr int argoffset =
+            (std::is_member_function_pointer<FuncType>::value ? 1 : 0);
+        return DoDefMember(name, GetStaticFunction<FuncType, f, argoffset>());
+    }
+
+#if __cplusplus >= 201703L
+    // e.g. `DefMember<&Point::Sum>("sum")`
+    template <auto f>
+    LuaClass& DefMember(const char* name) {
+        return DefMember<decltype(f), f>(name);
+    }
+#endif
+
+    /*
+       member field bound at compile time, e.g.
+       `DefField<decltype(&Point::x), &Point::x>("x")`.
+    */
+    template <typename MemberPtrType, MemberPtrType field>
+    LuaClass& DefField(const char* name) {
+        static_assert(!std::is_const<typename MemberObjectTraits<
+                          MemberPtrType>::value_type>::value,
+                      "use `DefReadOnlyField()` for const fields");
+        return DoDefField<MemberPtrType, field, false>(name);
+    }
+
+    template <typename MemberPtrType, MemberPtrType field>
+    LuaClass& DefReadOnlyField(const char* name) {
+        return DoDefField<MemberPtrType, field, true>(name);
+    }
+
+#if __cplusplus >= 201703L
+    // e.g. `DefField<&Point::x>("x")`
+    template <auto field>
+    LuaClass& DefField(const char* name) {
+        return DefField<decltype(field), field>(name);
+    }
+
+    template <auto field>
+    LuaClass& DefReadOnlyField(const char* name) {
+        return DefReadOnlyField<decltype(field), field>(name);
+    }
+#endif
+
     /* ----------------------------- static --------------------------------- */
 
     /*
@@ -253,17 +539,16 @@ public:
     template <typename PropertyType, typename GetterType, typename SetterType>
     LuaClass& DefStatic(const char* name, GetterType&& getter,
                         SetterType&& setter) {
-        std::function<PropertyType(void)> getter_func(
-            std::forward<GetterType>(getter));
-        std::function<void(PropertyType)> setter_func(
-            std::forward<SetterType>(setter));
+        using WrapperType =
+            StaticPropertyWrapper<PropertyType, GetterType, SetterType>;
 
         PushSelf();
         lua_getmetatable(m_l, -1);
-        CreateStaticProperty(m_l, std::move(getter_func),
-                             std::move(setter_func));
+        CreateProperty<WrapperType>(m_l, std::forward<GetterType>(getter),
+                                    std::forward<SetterType>(setter));
         lua_setfield(m_l, -2, name);
         lua_pop(m_l, 2);
+        InvalidateLookupTable();
 
         return *this;
     }
@@ -273,6 +558,20 @@ public:
         return DoDefStatic(name, std::forward<FuncType>(f));
     }
 
+    // static member function `f` known at compile time
+    template <typename FuncType, FuncType f>
+    LuaClass& DefStatic(const char* name) {
+        return DoDefStatic(name, GetStaticFunction<FuncType, f, 1>());
+    }
+
+#if __cplusplus >= 201703L
+    // e.g. `DefStatic<&ClassDemo::StaticEcho>("StaticEcho")`
+    template <auto f>
+    LuaClass& DefStatic(const char* name) {
+        return DefStatic<decltype(f), f>(name);
+    }
+#endif
+
     /* ---------------------------------------------------------------------- */
 
     template <typename BaseType>
@@ -280,8 +579,28 @@ public:
         PushParentsTable();
         auto len = lua_rawlen(m_l, -1);
         PushValue(m_l, lclass);
+        for (lua_Unsigned i = 1; i <= len; ++i) {
+            lua_rawgeti(m_l, -2, i);
+            bool added = lua_rawequal(m_l, -1, -2);
+            lua_pop(m_l, 1);
+            if (added) {
+                lua_pop(m_l, 2);
+                return *this;
+            }
+        }
         lua_rawseti(m_l, -2, len + 1);
         lua_pop(m_l, 1);
+
+        // records this class in `lclass` so that changes of `lclass` can be
+        // propagated to this class
+        PushValue(m_l, lclass);
+        lua_getiuservalue(m_l, -1, CLASS_CHILDREN_TABLE_IDX);
+        PushSelf();
+        lua_pushboolean(m_l, 1);
+        lua_rawset(m_l, -3);
+        lua_pop(m_l, 2);
+
+        InvalidateLookupTable();
         return *this;
     }
 
@@ -7,9 +7,46 @@
 
 namespace luacpp {
 
+/*
+  calls the function below `argc` arguments on the top of the stack, and stores
+  exactly `sizeof...(R)` results into `results`(if not nullptr). results are
+  converted directly from the stack.
+
+  results are popped before returning, and a string that is not referenced
+  elsewhere can be freed by the next gc step, so `const char*` and
+  `LuaStringRef` results would point to freed memory. use `std::string`, or
+  `LuaFunction::ForEachCall()` whose sink receives borrowed results that are
+  valid inside the sink.
+*/
+template <typename... R>
+bool CallFunction(lua_State* l, int argc, std::tuple<R...>* results,
+                  std::string* errstr) {
+    static_assert(!HasBorrowedType<R...>::value,
+                  "results are popped after the call and strings may be "
+                  "freed. use `std::string`, or `ForEachCall()` to get "
+                  "`const char*` or `LuaStringRef` results in the sink.");
+
+    constexpr int nresults = sizeof...(R);
+    if (lua_pcall(l, argc, nresults, 0) != LUA_OK) {
+        if (errstr) {
+            *errstr = lua_tostring(l, -1);
+        }
+        lua_pop(l, 1);
+        return false;
+    }
+
+    if (results) {
+        TupleConverter<sizeof...(R)>::Convert(l, lua_gettop(l) - nresults + 1,
+                                              results);
+    }
+    lua_pop(l, nresults);
+    return true;
+}
+
 class LuaFunction final : public LuaRefObject {
 public:
-    LuaFunction(lua_State* l, int index) : LuaRefObject(l, index) {}
+    LuaFunction(lua_State* l, int index, LuaScope* scope = nullptr)
+        : LuaRefObject(l, index, scope) {}
     LuaFunction(LuaObject&& lobj) : LuaRefObject(std::move(lobj)) {}
     LuaFunction(const LuaObject& lobj) : LuaRefObject(lobj) {}
     LuaFunction(LuaFunction&&) = default;
@@ -28,7 +65,93 @@ public:
         return Invoke(callback, sizeof...(Argv), errstr);
     }
 
+    /*
+      calls this function and converts results to `R...` directly, e.g.
+
+      std::tuple<int, std::string> res;
+      f.Call(&res, &errstr, 1, "a");
+    */
+    template <typename... R, typename... Argv>
+    bool Call(std::tuple<R...>* results, std::string* errstr,
+              Argv&&... argv) {
+        PushSelf();
+        PushValues(m_l, std::forward<Argv>(argv)...);
+        return CallFunction(m_l, sizeof...(Argv), results, errstr);
+    }
+
+    /*
+      calls this function once for each element of `range` and returns the
+      number of elements processed. the function is pushed only once and the
+      same stack frame is reused for every call.
+        - mapper: (const Element&) -> Arg or std::tuple<Arg...>, converting
+          an element to argument(s) of this function.
+        - sink: (uint64_t i, R... results) -> bool, receiving results of the
+          i-th call. results are only valid in `sink`. returns false to stop.
+        - on_error: (uint64_t i, const char* errmsg) -> bool, called when the
+          i-th call fails. `errmsg` contains a traceback. returns false to
+          stop. errors are ignored if `on_error` is not present.
+    */
+    template <typename RangeType, typename MapperType, typename SinkType,
+              typename ErrorHandlerType>
+    uint64_t ForEachCall(const RangeType& range, MapperType&& mapper,
+                         SinkType&& sink, ErrorHandlerType&& on_error) {
+        return DoForEachCall(range, mapper, sink, on_error, true);
+    }
+
+    template <typename RangeType, typename MapperType, typename SinkType>
+    uint64_t ForEachCall(const RangeType& range, MapperType&& mapper,
+                         SinkType&& sink) {
+        auto on_error = [](uint64_t, const char*) -> bool {
+            return true;
+        };
+        return DoForEachCall(range, mapper, sink, on_error, false);
+    }
+
 private:
+    // `TracebackMessageHandler` is pushed only once for the whole batch, and
+    // only if errors are reported, since nobody reads tracebacks otherwise
+    template <typename RangeType, typename MapperType, typename SinkType,
+              typename ErrorHandlerType>
+    uint64_t DoForEachCall(const RangeType& range, MapperType& mapper,
+                           SinkType& sink, ErrorHandlerType& on_error,
+                           bool with_traceback) {
+        constexpr int nresults =
+            FunctionTraits<typename std::decay<SinkType>::type>::argc - 1;
+
+        int msgh_idx = 0;
+        if (with_traceback) {
+            lua_pushcfunction(m_l, TracebackMessageHandler);
+            msgh_idx = lua_gettop(m_l);
+        }
+
+        PushSelf();
+        const int func_idx = lua_gettop(m_l);
+
+        uint64_t i = 0;
+        for (auto&& item : range) {
+            lua_pushvalue(m_l, func_idx);
+            int argc = PushArguments(m_l, mapper(item));
+
+            bool go_on;
+            if (lua_pcall(m_l, argc, nresults, msgh_idx) == LUA_OK) {
+                go_on = ResultsApplier<nresults>::Apply(sink, m_l,
+                                                        func_idx + 1, i);
+            } else {
+                go_on = on_error(i, lua_tostring(m_l, -1));
+            }
+            lua_settop(m_l, func_idx);
+
+            ++i;
+            if (!go_on) {
+                break;
+            }
+        }
+
+        // the function itself and the message handler
+        lua_pop(m_l, with_traceback ? 2 : 1);
+        return i;
+    }
+
     // i starts from 0
     bool Invoke(
         const std::function<bool(uint32_t i, const LuaObject)>& callback,
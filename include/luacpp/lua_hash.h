@@ -0,0 +1,33 @@
+#ifndef __LUA_CPP_LUA_HASH_H__
+#define __LUA_CPP_LUA_HASH_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace luacpp {
+
+// FNV-1a over 64-bit words, with an extra shift to mix high bits into low bits
+inline uint64_t HashBytes(const char* data, size_t len) {
+    const uint64_t prime = 1099511628211ull;
+    uint64_t h = 14695981039346656037ull ^ len;
+
+    for (; len >= sizeof(uint64_t); len -= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        h = (h ^ word) * prime;
+        h ^= (h >> 32);
+        data += sizeof(uint64_t);
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        h = (h ^ (unsigned char)data[i]) * prime;
+    }
+    h ^= (h >> 32);
+
+    return h;
+}
+
+}
+
+#endif
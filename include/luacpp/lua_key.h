@@ -0,0 +1,27 @@
+#ifndef __LUA_CPP_LUA_KEY_H__
+#define __LUA_CPP_LUA_KEY_H__
+
+#include "lua_ref_object.h"
+
+namespace luacpp {
+
+/*
+  A string key interned once and anchored in the registry. Getters and setters
+  taking a `LuaKey` use `lua_rawget()`/`lua_rawset()` with the interned string,
+  so the key is neither copied nor hashed again, and metamethods are NOT
+  triggered.
+*/
+class LuaKey final : public LuaRefObject {
+public:
+    // keys are never stored in scopes
+    LuaKey(lua_State* l, int index) : LuaRefObject(l, index, nullptr) {}
+    LuaKey(LuaKey&&) = default;
+    LuaKey(const LuaKey&) = default;
+
+    LuaKey& operator=(LuaKey&&) = default;
+    LuaKey& operator=(const LuaKey&) = default;
+};
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef __LUA_CPP_LUA_MEMORY_LIMIT_ALLOCATOR_H__
+#define __LUA_CPP_LUA_MEMORY_LIMIT_ALLOCATOR_H__
+
+#include "lua_allocator.h"
+#include <stdint.h>
+#include <stddef.h>
+
+namespace luacpp {
+
+/*
+  An allocator that tracks live bytes of a state and enforces limits on them.
+  Creating an object above the soft limit fails once, so that lua runs an
+  emergency full gc and tries again; it is re-armed when the usage drops below
+  the soft limit. Other allocations never fail because of the soft limit,
+  since some of them, e.g. buffers of `luaL_Buffer`, are not retried by lua.
+  Growing above the hard limit always fails, and lua raises a "not enough
+  memory" error. 0 means no limit.
+*/
+class LuaMemoryLimitAllocator final : public LuaAllocator {
+public:
+    struct Stats final {
+        uint64_t current_bytes;
+        uint64_t peak_bytes;
+        uint64_t soft_limit;
+        uint64_t hard_limit;
+        uint64_t soft_limit_hits; // number of emergency gc triggered
+    };
+
+public:
+    LuaMemoryLimitAllocator();
+
+    LuaMemoryLimitAllocator(const LuaMemoryLimitAllocator&) = delete;
+    LuaMemoryLimitAllocator& operator=(const LuaMemoryLimitAllocator&) =
+        delete;
+
+    void SetLimits(uint64_t soft_limit, uint64_t hard_limit);
+    void GetStats(Stats*) const;
+
+private:
+    static void* Alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+    void UpdateThreshold();
+
+    // returns false if the allocation should fail
+    bool CheckLimits(void* ptr, size_t nsize, uint64_t next,
+                     bool is_new_object);
+
+private:
+    uint64_t m_current;
+    uint64_t m_peak;
+    uint64_t m_soft_limit;
+    uint64_t m_hard_limit;
+    uint64_t m_soft_limit_hits;
+
+    /*
+      min(soft, hard) of non-zero limits, or UINT64_MAX if there is no limit.
+      growing above it goes to `CheckLimits()`.
+    */
+    uint64_t m_threshold;
+    bool m_soft_limit_armed;
+
+    // the request waiting for the retry after an emergency gc
+    bool m_retrying;
+    void* m_retry_ptr;
+    size_t m_retry_nsize;
+};
+
+}
+
+#endif
@@ -9,7 +9,8 @@ namespace luacpp {
 class LuaObject final : public LuaRefObject {
 public:
     LuaObject(lua_State* l) : LuaRefObject(l) {}
-    LuaObject(lua_State* l, int index) : LuaRefObject(l, index) {}
+    LuaObject(lua_State* l, int index, LuaScope* scope = nullptr)
+        : LuaRefObject(l, index, scope) {}
     LuaObject(LuaObject&& rhs) : LuaRefObject(std::move(rhs)) {}
     LuaObject(const LuaObject& rhs) : LuaRefObject(rhs) {}
 
@@ -0,0 +1,56 @@
+#ifndef __LUA_CPP_LUA_PATH_H__
+#define __LUA_CPP_LUA_PATH_H__
+
+#include "lua_key.h"
+#include <string>
+#include <vector>
+
+namespace luacpp {
+
+/*
+  A path like `upstream.pool.max_conns` or `servers[2]["host name"]` compiled
+  by `LuaState::CreatePath()` into a sequence of interned keys and integer
+  indices. Getters taking a `LuaPath` walk the path on the stack without
+  creating intermediate references. Like `LuaKey`, every step is a raw access
+  without metamethods.
+*/
+class LuaPath final {
+public:
+    LuaPath() {}
+    LuaPath(LuaPath&&) = default;
+    LuaPath(const LuaPath&) = default;
+
+    LuaPath& operator=(LuaPath&&) = default;
+    LuaPath& operator=(const LuaPath&) = default;
+
+    uint32_t GetDepth() const {
+        return m_segments.size();
+    }
+
+    /*
+      pushes the value of this path starting from the table at `idx`. pushes
+      `nil` if any intermediate value is not a table.
+    */
+    void PushValue(lua_State* l, int idx) const;
+
+private:
+    friend class LuaState;
+
+    bool Compile(lua_State* l, const char* path, std::string* errstr);
+    bool CompileBracket(lua_State* l, const char** cursor);
+    bool CompileName(lua_State* l, const char** cursor);
+    void AddKey(lua_State* l, const char* key, size_t len);
+
+private:
+    struct Segment final {
+        lua_Integer index;
+        int key_idx; // index of `m_keys`, or -1 if `index` is used
+    };
+
+    std::vector<Segment> m_segments;
+    std::vector<LuaKey> m_keys;
+};
+
+}
+
+#endif
@@ -7,20 +7,58 @@ extern "C" {
 }
 
 #include "func_utils.h"
+#include "lua_52_53.h"
+#include "lua_scope.h"
 #include <utility> // std::move
 
 namespace luacpp {
 
+/*
+  nil, booleans, numbers and light userdata are immutable and not collectable,
+  so they are stored in the object itself without creating any reference in
+  the registry.
+
+  copies of other objects share the same reference, which is released when the
+  last copy is destroyed. the reference counter is allocated on the first
+  copy. objects created by a `LuaScope` keep values in the scope instead.
+*/
 class LuaRefObject {
 public:
     LuaRefObject(lua_State* l)
         : m_l(l), m_type(LUA_TNIL), m_ref_index(LUA_REFNIL) {}
 
-    LuaRefObject(lua_State* l, int index) {
+    // `scope` can be nullptr
+    LuaRefObject(lua_State* l, int index, LuaScope* scope = nullptr) {
         m_l = l;
         m_type = lua_type(l, index);
-        lua_pushvalue(l, index);
-        m_ref_index = luaL_ref(l, LUA_REGISTRYINDEX);
+        m_ref_index = LUA_REFNIL;
+
+        switch (m_type) {
+            case LUA_TNIL:
+                break;
+            case LUA_TBOOLEAN:
+                m_value.b = lua_toboolean(l, index);
+                break;
+            case LUA_TNUMBER:
+                m_is_integer = lua_isinteger(l, index);
+                if (m_is_integer) {
+                    m_value.i = lua_tointeger(l, index);
+                } else {
+                    m_value.n = lua_tonumber(l, index);
+                }
+                break;
+            case LUA_TLIGHTUSERDATA:
+                m_value.p = lua_touserdata(l, index);
+                break;
+            default:
+                if (scope) {
+                    m_scope_ref = scope->GetTableRef();
+                    m_ref_index = scope->Add(l, index);
+                } else {
+                    lua_pushvalue(l, index);
+                    m_ref_index = luaL_ref(l, LUA_REGISTRYINDEX);
+                }
+        }
     }
 
     LuaRefObject(LuaRefObject&& rhs) {
@@ -28,10 +66,7 @@ public:
     }
 
     LuaRefObject(const LuaRefObject& rhs) {
-        m_l = rhs.m_l;
-        m_type = rhs.m_type;
-        PushValue(m_l, rhs);
-        m_ref_index = luaL_ref(m_l, LUA_REGISTRYINDEX);
+        CopyFunc(rhs);
     }
 
     LuaRefObject& operator=(LuaRefObject&& rhs) {
@@ -39,9 +74,7 @@ public:
             return *this;
         }
 
-        if (m_l) {
-            luaL_unref(m_l, LUA_REGISTRYINDEX, m_ref_index);
-        }
+        Release();
         MoveFunc(std::move(rhs));
         return *this;
     }
@@ -51,22 +84,13 @@ public:
             return *this;
         }
 
-        if (m_l) {
-            luaL_unref(m_l, LUA_REGISTRYINDEX, m_ref_index);
-        }
-
-        m_l = rhs.m_l;
-        m_type = rhs.m_type;
-        PushValue(m_l, rhs);
-        m_ref_index = luaL_ref(m_l, LUA_REGISTRYINDEX);
+        Release();
+        CopyFunc(rhs);
         return *this;
     }
 
     virtual ~LuaRefObject() {
-        // m_l is nullptr if object was moved to another object
-        if (m_l) {
-            luaL_unref(m_l, LUA_REGISTRYINDEX, m_ref_index);
-        }
+        Release();
     }
 
     int GetType() const {
@@ -75,32 +99,129 @@ public:
     const char* GetTypeName() const {
         return lua_typename(m_l, m_type);
     }
+
+    /*
+      returns `LUA_REFNIL` if this object is stored inline. for objects in
+      scopes, it is the index in the scope table.
+    */
     int GetRefIndex() const {
         return m_ref_index;
     }
 
+    // pushes this object onto the stack of `l`
+    void PushTo(lua_State* l) const {
+        if (m_ref_index != LUA_REFNIL) {
+            if (m_scope_ref == LUA_NOREF) {
+                lua_rawgeti(l, LUA_REGISTRYINDEX, m_ref_index);
+            } else {
+                lua_rawgeti(l, LUA_REGISTRYINDEX, m_scope_ref);
+                lua_rawgeti(l, -1, m_ref_index);
+                lua_replace(l, -2);
+            }
+            return;
+        }
+
+        switch (m_type) {
+            case LUA_TBOOLEAN:
+                lua_pushboolean(l, m_value.b);
+                break;
+            case LUA_TNUMBER:
+                if (m_is_integer) {
+                    lua_pushinteger(l, m_value.i);
+                } else {
+                    lua_pushnumber(l, m_value.n);
+                }
+                break;
+            case LUA_TLIGHTUSERDATA:
+                lua_pushlightuserdata(l, m_value.p);
+                break;
+            default:
+                lua_pushnil(l);
+        }
+    }
+
 protected:
     void PushSelf() const {
-        lua_rawgeti(m_l, LUA_REGISTRYINDEX, m_ref_index);
+        PushTo(m_l);
+    }
+
+    bool IsInline() const {
+        return (m_ref_index == LUA_REFNIL);
     }
 
 private:
+    void Release() {
+        // m_l is nullptr if object was moved to another object. values in
+        // scopes are released with scopes.
+        if (!m_l || m_ref_index == LUA_REFNIL || m_scope_ref != LUA_NOREF) {
+            return;
+        }
+
+        if (m_refcount) {
+            --(*m_refcount);
+            if (*m_refcount > 0) {
+                return;
+            }
+            delete m_refcount;
+        }
+
+        luaL_unref(m_l, LUA_REGISTRYINDEX, m_ref_index);
+    }
+
+    void CopyFunc(const LuaRefObject& rhs) {
+        m_l = rhs.m_l;
+        m_type = rhs.m_type;
+        m_is_integer = rhs.m_is_integer;
+        m_value = rhs.m_value;
+        m_ref_index = rhs.m_ref_index;
+        m_scope_ref = rhs.m_scope_ref;
+        m_refcount = nullptr;
+
+        if (!rhs.IsInline() && m_scope_ref == LUA_NOREF) {
+            if (!rhs.m_refcount) {
+                rhs.m_refcount = new uint32_t(1);
+            }
+            ++(*rhs.m_refcount);
+            m_refcount = rhs.m_refcount;
+        }
+    }
+
     void MoveFunc(LuaRefObject&& rhs) {
         m_l = rhs.m_l;
         m_type = rhs.m_type;
+        m_is_integer = rhs.m_is_integer;
+        m_value = rhs.m_value;
         m_ref_index = rhs.m_ref_index;
+        m_scope_ref = rhs.m_scope_ref;
+        m_refcount = rhs.m_refcount;
 
         rhs.m_l = nullptr;
         rhs.m_type = LUA_TNIL;
         rhs.m_ref_index = LUA_REFNIL;
+        rhs.m_refcount = nullptr;
     }
 
 protected:
     lua_State* m_l;
 
+    // valid only if this object is stored inline
+    union Value {
+        bool b;
+        lua_Integer i;
+        lua_Number n;
+        void* p;
+    } m_value = Value();
+    bool m_is_integer = false;
+
 private:
     int m_type;
-    int m_ref_index;
+    int m_ref_index; // index in the registry or the scope table
+
+    // reference of the scope table, or `LUA_NOREF` if not in a scope
+    int m_scope_ref = LUA_NOREF;
+
+    // number of objects sharing `m_ref_index`, or nullptr if not shared yet
+    mutable uint32_t* m_refcount = nullptr;
 };
 
 }
@@ -0,0 +1,93 @@
+#ifndef __LUA_CPP_LUA_SCOPE_H__
+#define __LUA_CPP_LUA_SCOPE_H__
+
+extern "C" {
+#include "lua.h"
+#include "lauxlib.h"
+}
+
+#include <stdint.h>
+
+namespace luacpp {
+
+class LuaState;
+class LuaObject;
+
+/*
+  An arena for short-lived objects. Objects created by a scope keep their
+  values in a table owned by the scope instead of creating references in the
+  registry. Destroying these objects costs nothing, and all values are
+  released at once when the scope is destroyed. e.g.
+
+  {
+      LuaScope scope(l);
+      auto name = scope.Get(tbl, "name"); // stored in the scope
+      auto copy = tbl.Get("name"); // not affected by the scope
+      ...
+  } // `name` is released here
+
+  Objects created by a scope(and their copies) MUST NOT be used after the
+  scope is destroyed. Values are not released before the scope is destroyed
+  even if their objects are, so a scope should not live long, e.g. one scope
+  for every iteration of a loop.
+*/
+class LuaScope final {
+public:
+    explicit LuaScope(lua_State* l);
+    explicit LuaScope(LuaState& l);
+    ~LuaScope();
+
+    LuaScope(const LuaScope&) = delete;
+    LuaScope(LuaScope&&) = delete;
+    LuaScope& operator=(const LuaScope&) = delete;
+    LuaScope& operator=(LuaScope&&) = delete;
+
+    // returns the number of values stored in this scope
+    uint32_t GetSize() const {
+        return m_size;
+    }
+
+    /*
+      gets the value of `key` in `src`, which is a `LuaTable` or a `LuaState`
+      for global variables, as an object of type `T` kept in this scope. `key`
+      can be any key type accepted by getters of `src`.
+    */
+    template <typename T = LuaObject, typename SrcType, typename KeyType>
+    T Get(const SrcType& src, const KeyType& key) {
+        return src.template GenericGetObject<T>(key, this);
+    }
+
+    // creates an object of type `T` kept in this scope for the value at `index`
+    template <typename T = LuaObject>
+    T Create(int index) {
+        return T(m_l, index, this);
+    }
+
+private:
+    friend class LuaRefObject;
+
+    int GetTableRef() const {
+        return m_table_ref;
+    }
+
+    // stores the value at `index` and returns its index in the table
+    int Add(lua_State* l, int index) {
+        index = lua_absindex(l, index);
+        lua_rawgeti(l, LUA_REGISTRYINDEX, m_table_ref);
+        lua_pushvalue(l, index);
+        lua_rawseti(l, -2, ++m_size);
+        lua_pop(l, 1);
+        return (int)m_size;
+    }
+
+    void Init(lua_State* l);
+
+private:
+    lua_State* m_l;
+    int m_table_ref;
+    uint32_t m_size;
+};
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef __LUA_CPP_LUA_SLAB_ALLOCATOR_H__
+#define __LUA_CPP_LUA_SLAB_ALLOCATOR_H__
+
+#include "lua_allocator.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace luacpp {
+
+/*
+  An allocator that serves small blocks from per-size-class slabs. Size
+  classes are multiples of 16 bytes up to 256 bytes, which cover short
+  strings, tables, closures and most userdata of exported classes, and
+  multiples of 32 bytes up to 512 bytes. Larger blocks are allocated by
+  `realloc()`. Freed blocks are kept in free lists of their size classes and
+  slabs are released when the allocator is destroyed.
+*/
+class LuaSlabAllocator final : public LuaAllocator {
+public:
+    struct SizeClassStats final {
+        uint32_t block_size;
+        uint64_t used_blocks; // blocks allocated by lua
+        uint64_t total_blocks; // blocks carved from slabs
+        uint64_t requested_bytes; // sum of sizes requested by used blocks
+    };
+
+    struct Stats final {
+        std::vector<SizeClassStats> size_classes;
+        uint64_t large_blocks;
+        uint64_t large_bytes;
+        uint64_t slab_bytes; // bytes of all slabs
+
+        /*
+          bytes in slabs that are not requested by lua, including free blocks
+          and padding of used blocks, divided by `slab_bytes`.
+        */
+        double fragmentation;
+    };
+
+public:
+    LuaSlabAllocator();
+    ~LuaSlabAllocator();
+
+    LuaSlabAllocator(const LuaSlabAllocator&) = delete;
+    LuaSlabAllocator& operator=(const LuaSlabAllocator&) = delete;
+
+    void GetStats(Stats*) const;
+
+private:
+    static void* Alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+    void* AllocBlock(uint32_t class_idx);
+    void FreeBlock(uint32_t class_idx, void* ptr);
+    void* KeepBlock(void* ptr, size_t osize, uint32_t old_idx,
+                    uint32_t new_idx, size_t nsize);
+    void* Realloc(void* ptr, size_t osize, size_t nsize);
+    void Free(void* ptr, size_t osize);
+
+private:
+    struct FreeBlockNode final {
+        FreeBlockNode* next;
+    };
+
+    // slabs are linked by headers in front of their blocks
+    struct SlabHeader final {
+        SlabHeader* next;
+    };
+
+    struct SizeClass final {
+        uint32_t block_size;
+        FreeBlockNode* free_list;
+        uint64_t used_blocks;
+        uint64_t total_blocks;
+        uint64_t requested_bytes;
+    };
+
+    std::vector<SizeClass> m_classes;
+    SlabHeader* m_slabs;
+    uint64_t m_slab_bytes;
+    uint64_t m_large_blocks;
+    uint64_t m_large_bytes;
+};
+
+}
+
+#endif
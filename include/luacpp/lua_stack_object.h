@@ -0,0 +1,58 @@
+#ifndef __LUA_CPP_LUA_STACK_OBJECT_H__
+#define __LUA_CPP_LUA_STACK_OBJECT_H__
+
+extern "C" {
+#include "lua.h"
+}
+
+#include "lua_string_ref.h"
+
+namespace luacpp {
+
+/*
+  A borrowed view of a value on the lua stack. It does not create any
+  reference, so it is only valid as long as the value stays in the stack
+  slot, e.g. as an argument of an exported function during the call.
+*/
+class LuaStackObject final {
+public:
+    LuaStackObject(lua_State* l, int index)
+        : m_l(l), m_index(lua_absindex(l, index)) {}
+
+    int GetType() const {
+        return lua_type(m_l, m_index);
+    }
+    const char* GetTypeName() const {
+        return lua_typename(m_l, GetType());
+    }
+    int GetIndex() const {
+        return m_index;
+    }
+
+    bool ToBool() const {
+        return lua_toboolean(m_l, m_index);
+    }
+    lua_Number ToNumber() const {
+        return lua_tonumber(m_l, m_index);
+    }
+    lua_Integer ToInteger() const {
+        return lua_tointeger(m_l, m_index);
+    }
+    LuaStringRef ToStringRef() const {
+        return LuaStringRef(m_l, m_index);
+    }
+    const char* ToString() const {
+        return lua_tostring(m_l, m_index);
+    }
+    void* ToPointer() const {
+        return lua_touserdata(m_l, m_index);
+    }
+
+private:
+    lua_State* m_l;
+    int m_index; // absolute index
+};
+
+}
+
+#endif
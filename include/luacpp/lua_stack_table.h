@@ -0,0 +1,152 @@
+#ifndef __LUA_CPP_LUA_STACK_TABLE_H__
+#define __LUA_CPP_LUA_STACK_TABLE_H__
+
+extern "C" {
+#include "lua.h"
+}
+
+#include "lua_string_ref.h"
+#include <stdint.h>
+
+namespace luacpp {
+
+class LuaRefObject;
+class LuaObject;
+class LuaTable;
+class LuaFunction;
+class LuaKey;
+
+template <typename T>
+class LuaClass;
+
+template <typename FuncType>
+bool IterateTable(lua_State* l, int idx, FuncType& f);
+
+/*
+  A borrowed view of a table on the lua stack, with the same getters and
+  setters as `LuaTable`. It does not create any reference, so it is only valid
+  as long as the table stays in the stack slot, e.g. as an argument of an
+  exported function during the call.
+*/
+class LuaStackTable {
+public:
+    LuaStackTable(lua_State* l, int index)
+        : m_l(l), m_index(lua_absindex(l, index)) {}
+
+    int GetType() const {
+        return lua_type(m_l, m_index);
+    }
+    const char* GetTypeName() const {
+        return lua_typename(m_l, GetType());
+    }
+    int GetIndex() const {
+        return m_index;
+    }
+
+    // ----- getters ----- //
+
+    LuaObject Get(int index) const;
+    LuaObject Get(const char* name) const;
+    LuaObject Get(const LuaKey& key) const;
+
+    LuaTable GetTable(int index) const;
+    LuaTable GetTable(const char* name) const;
+    LuaTable GetTable(const LuaKey& key) const;
+
+    LuaFunction GetFunction(int index) const;
+    LuaFunction GetFunction(const char* name) const;
+    LuaFunction GetFunction(const LuaKey& key) const;
+
+    template <typename T>
+    LuaClass<T> GetClass(int index) const {
+        lua_rawgeti(m_l, m_index, index);
+        LuaClass<T> ret(m_l, -1);
+        lua_pop(m_l, 1);
+        return ret;
+    }
+
+    template <typename T>
+    LuaClass<T> GetClass(const char* name) const {
+        lua_getfield(m_l, m_index, name);
+        LuaClass<T> ret(m_l, -1);
+        lua_pop(m_l, 1);
+        return ret;
+    }
+
+    template <typename T>
+    LuaClass<T> GetClass(const LuaKey& key) const {
+        PushRawField(key);
+        LuaClass<T> ret(m_l, -1);
+        lua_pop(m_l, 1);
+        return ret;
+    }
+
+    LuaStringRef GetStringRef(int index) const;
+    LuaStringRef GetStringRef(const char* name) const;
+    LuaStringRef GetStringRef(const LuaKey& key) const;
+
+    const char* GetString(int index) const;
+    const char* GetString(const char* name) const;
+    const char* GetString(const LuaKey& key) const;
+
+    lua_Number GetNumber(int index) const;
+    lua_Number GetNumber(const char* name) const;
+    lua_Number GetNumber(const LuaKey& key) const;
+
+    lua_Integer GetInteger(int index) const;
+    lua_Integer GetInteger(const char* name) const;
+    lua_Integer GetInteger(const LuaKey& key) const;
+
+    void* GetPointer(int index) const;
+    void* GetPointer(const char* name) const;
+    void* GetPointer(const LuaKey& key) const;
+
+    // ----- setters ----- //
+
+    void Set(int index, const LuaRefObject& lobj);
+    void Set(const char* name, const LuaRefObject& lobj);
+    void Set(const LuaKey& key, const LuaRefObject& lobj);
+
+    void SetString(int index, const char* str);
+    void SetString(int index, const char* str, uint64_t len);
+    void SetString(const char* name, const char* str);
+    void SetString(const char* name, const char* str, uint64_t len);
+    void SetString(const LuaKey& key, const char* str);
+    void SetString(const LuaKey& key, const char* str, uint64_t len);
+
+    void SetNumber(int index, lua_Number);
+    void SetNumber(const char* name, lua_Number);
+    void SetNumber(const LuaKey& key, lua_Number);
+
+    void SetInteger(int index, lua_Integer);
+    void SetInteger(const char* name, lua_Integer);
+    void SetInteger(const LuaKey& key, lua_Integer);
+
+    void SetPointer(int index, void*);
+    void SetPointer(const char* name, void*);
+    void SetPointer(const LuaKey& key, void*);
+
+    // ----- //
+
+    uint64_t GetSize() const {
+        return lua_rawlen(m_l, m_index);
+    }
+
+    // see `LuaTable::ForEach()`
+    template <typename FuncType>
+    bool ForEach(FuncType&& f) const {
+        return IterateTable(m_l, m_index, f);
+    }
+
+private:
+    // pushes the value of `key` in this table
+    void PushRawField(const LuaKey& key) const;
+
+protected:
+    lua_State* m_l;
+    int m_index; // absolute index
+};
+
+}
+
+#endif
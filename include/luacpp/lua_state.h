@@ -9,12 +9,20 @@ extern "C" {
 #include "lua_class.h"
 #include "lua_table.h"
 #include "lua_function.h"
+#include "lua_allocator.h"
+#include "lua_chunk_cache.h"
 #include <functional>
+#include <memory>
+#include <chrono>
+#include <iosfwd>
+#include <limits.h>
 
 namespace luacpp {
 
 class LuaState final {
 private:
+    friend class LuaScope;
+
     template <typename FuncType>
     LuaFunction DoCreateFunctionImpl(FuncType&& f, const char* name) {
         CreateGenericFunction(m_l, m_gc_table_ref, 0,
@@ -29,15 +37,24 @@ private:
         return ret;
     }
 
+    template <typename FuncType>
+    LuaFunction DoCreateFunctionImpl(FuncType&& f, const char* name,
+                                     std::true_type /* is lua-style */) {
+        return DoCreateFunction(
+            static_cast<int (*)(lua_State*)>(std::forward<FuncType>(f)), name);
+    }
+
+    template <typename FuncType>
+    LuaFunction DoCreateFunctionImpl(FuncType&& f, const char* name,
+                                     std::false_type /* is lua-style */) {
+        return DoCreateFunctionImpl(std::forward<FuncType>(f), name);
+    }
+
     // c-style functions, `std::function`s and lambda functions
     template <typename FuncType>
     LuaFunction DoCreateFunction(FuncType&& f, const char* name = nullptr) {
-        using RealFuncType = typename std::remove_reference<FuncType>::type;
-        using ConvertedFuncType = typename std::conditional<
-            std::is_pointer<RealFuncType>::value, RealFuncType,
-            typename FunctionTraits<RealFuncType>::std_function_type>::type;
-        ConvertedFuncType func(std::forward<FuncType>(f));
-        return DoCreateFunctionImpl(std::move(func), name);
+        return DoCreateFunctionImpl(std::forward<FuncType>(f), name,
+                                    IsLuaCFunction<FuncType>());
     }
 
     // lua-style functions that can be used to implement variadic argument
@@ -64,6 +81,12 @@ private:
     void CreateClassMetatable(lua_State* l);
     void CreateClassInstanceMetatable(lua_State* l, int (*gc)(lua_State*));
 
+    /*
+      creates a state using `allocator`, which is owned by the returned state.
+      returns nullptr and deletes `allocator` if the state cannot be created.
+    */
+    static std::unique_ptr<LuaState> NewWithAllocator(LuaAllocator* allocator);
+
 public:
     LuaState(lua_State* l, bool is_owner);
     LuaState(LuaState&&);
@@ -73,28 +96,100 @@ public:
     LuaState& operator=(LuaState&&);
     LuaState& operator=(const LuaState&) = delete;
 
+    /*
+      the following functions install panic and warning handlers like
+      `luaL_newstate()`, and return nullptr if the state cannot be created.
+    */
+
+    // creates a state with standard libs using a `LuaSlabAllocator`
+    static std::unique_ptr<LuaState> NewWithSlabAllocator();
+
+    /*
+      creates a state with standard libs using a `LuaMemoryLimitAllocator`.
+      limits are applied after standard libs are loaded, and 0 means no limit.
+    */
+    static std::unique_ptr<LuaState> NewWithMemoryLimit(uint64_t soft_limit,
+                                                        uint64_t hard_limit);
+
+    /*
+      creates a state with standard libs using a `LuaArenaAllocator` whose
+      first chunk is `chunk_size` bytes. it is suitable for states that run a
+      few short scripts and are destroyed soon.
+    */
+    static std::unique_ptr<LuaState>
+    NewDisposable(size_t chunk_size = 64 * 1024);
+
+    /*
+      returns the allocator used by this state if it is created by
+      `NewWith*()` or `NewDisposable()` and the allocator is a `T`, otherwise
+      nullptr.
+    */
+    template <typename T>
+    const T* GetAllocator() const {
+        return dynamic_cast<const T*>(m_allocator);
+    }
+
     void Set(const char* name, const LuaRefObject& lobj);
+    void Set(const LuaKey& key, const LuaRefObject& lobj);
 
     LuaObject Get(const char* name) const {
         return GenericGetObject<LuaObject>(name);
     }
+    LuaObject Get(const LuaKey& key) const {
+        return GenericGetObject<LuaObject>(key);
+    }
+    LuaObject Get(const LuaPath& path) const {
+        return GenericGetObject<LuaObject>(path);
+    }
     LuaTable GetTable(const char* name) const {
         return GenericGetObject<LuaTable>(name);
     }
+    LuaTable GetTable(const LuaKey& key) const {
+        return GenericGetObject<LuaTable>(key);
+    }
+    LuaTable GetTable(const LuaPath& path) const {
+        return GenericGetObject<LuaTable>(path);
+    }
     LuaFunction GetFunction(const char* name) const {
         return GenericGetObject<LuaFunction>(name);
     }
+    LuaFunction GetFunction(const LuaKey& key) const {
+        return GenericGetObject<LuaFunction>(key);
+    }
+    LuaFunction GetFunction(const LuaPath& path) const {
+        return GenericGetObject<LuaFunction>(path);
+    }
 
     template <typename T>
     LuaClass<T> GetClass(const char* name) const {
         return GenericGetObject<LuaClass<T>>(name);
     }
 
+    template <typename T>
+    LuaClass<T> GetClass(const LuaKey& key) const {
+        return GenericGetObject<LuaClass<T>>(key);
+    }
+
+    template <typename T>
+    LuaClass<T> GetClass(const LuaPath& path) const {
+        return GenericGetObject<LuaClass<T>>(path);
+    }
+
     const char* GetString(const char* name) const;
+    const char* GetString(const LuaKey& key) const;
+    const char* GetString(const LuaPath& path) const;
     LuaStringRef GetStringRef(const char* name) const;
+    LuaStringRef GetStringRef(const LuaKey& key) const;
+    LuaStringRef GetStringRef(const LuaPath& path) const;
     lua_Number GetNumber(const char* name) const;
+    lua_Number GetNumber(const LuaKey& key) const;
+    lua_Number GetNumber(const LuaPath& path) const;
     lua_Integer GetInteger(const char* name) const;
+    lua_Integer GetInteger(const LuaKey& key) const;
+    lua_Integer GetInteger(const LuaPath& path) const;
     void* GetPointer(const char* name) const;
+    void* GetPointer(const LuaKey& key) const;
+    void* GetPointer(const LuaPath& path) const;
 
     void Push(const LuaRefObject& lobj) {
         PushValue(m_l, lobj);
@@ -127,6 +222,53 @@ public:
 
     LuaTable CreateTable(const char* name = nullptr);
 
+    /*
+      interns `str` as a key that can be used to access tables and globals
+      repeatedly. see `LuaKey`.
+    */
+    LuaKey CreateKey(const char* str);
+    LuaKey CreateKey(const char* str, uint64_t len);
+
+    /*
+      compiles `path` like `a.b[2]["c d"]` to `res`, which can be used to
+      get nested values from globals or tables. see `LuaPath`.
+    */
+    bool CreatePath(const char* path, LuaPath* res,
+                    std::string* errstr = nullptr);
+
+    /*
+      creates a table with `n` elements in `values` as its array part. `T`
+      can be any type that results of exported functions can be, including
+      `std::string` and `LuaStringRef`.
+    */
+    template <typename T>
+    LuaTable CreateArray(const T* values, uint64_t n,
+                         const char* name = nullptr) {
+        // the table, an element and a temporary slot used by some elements,
+        // e.g. objects kept in a `LuaScope`
+        luaL_checkstack(m_l, 3, "no stack space to create an array");
+        // only the size hint of the array part is limited to `int`
+        lua_createtable(m_l, (n > INT_MAX) ? INT_MAX : (int)n, 0);
+        for (uint64_t i = 0; i < n; ++i) {
+            PushValue(m_l, values[i]);
+            lua_rawseti(m_l, -2, i + 1);
+        }
+
+        LuaTable ret(m_l, -1);
+        if (name) {
+            lua_setglobal(m_l, name);
+        } else {
+            lua_pop(m_l, 1);
+        }
+        return ret;
+    }
+
+    template <typename T>
+    LuaTable CreateArray(const std::vector<T>& values,
+                         const char* name = nullptr) {
+        return CreateArray(values.data(), values.size(), name);
+    }
+
     LuaObject CreateNil() {
         return LuaObject(m_l);
     }
@@ -136,12 +278,31 @@ public:
         return DoCreateFunction(std::forward<FuncType>(f), name);
     }
 
+    /*
+      function `f` known at compile time, e.g.
+      `CreateFunction<decltype(&Add), &Add>("add")`. The created function has
+      no upvalue.
+    */
+    template <typename FuncType, FuncType f>
+    LuaFunction CreateFunction(const char* name = nullptr) {
+        return DoCreateFunction(GetStaticFunction<FuncType, f, 0>(), name);
+    }
+
+#if __cplusplus >= 201703L
+    // e.g. `CreateFunction<&Add>("add")`
+    template <auto f>
+    LuaFunction CreateFunction(const char* name = nullptr) {
+        return CreateFunction<decltype(f), f>(name);
+    }
+#endif
+
     template <typename T>
     LuaClass<T> CreateClass(const char* name = nullptr) {
-        auto ud =
-            (LuaClassData*)lua_newuserdatauv(m_l, sizeof(LuaClassData), 2);
+        auto ud = (LuaClassData*)lua_newuserdatauv(m_l, sizeof(LuaClassData),
+                                                   CLASS_USERVALUE_NUM);
         new (ud) LuaClassData();
         ud->gc_table_ref = m_gc_table_ref;
+        ud->property_metatable_ref = m_property_metatable_ref;
 
         // metatable for class itself
         CreateClassMetatable(m_l);
@@ -155,6 +316,17 @@ public:
         CreateClassInstanceMetatable(m_l, luacpp_generic_destructor<T>);
         lua_setiuservalue(m_l, -2, CLASS_INSTANCE_METATABLE_IDX);
 
+        // uservalue 3 is the lookup table, which is built on demand
+
+        // uservalue 4 is a set of derived classes with weak keys, so that
+        // derived classes are not kept alive by this class
+        lua_newtable(m_l);
+        lua_createtable(m_l, 0, 1);
+        lua_pushstring(m_l, "k");
+        lua_setfield(m_l, -2, "__mode");
+        lua_setmetatable(m_l, -2);
+        lua_setiuservalue(m_l, -2, CLASS_CHILDREN_TABLE_IDX);
+
         LuaClass<T> ret(m_l, -1);
         if (name) {
             lua_setglobal(m_l, name);
@@ -172,21 +344,186 @@ public:
         const char* script, std::string* errstr = nullptr,
         const std::function<bool(uint32_t, const LuaObject&)>& callback = {});
 
+    /*
+      same as `DoFile()`, except that `script` is mapped into memory and
+      loaded without being copied(it is read into a buffer on Windows).
+      `script` can be source code or a precompiled chunk, and must be a
+      regular file. the bytecode cache is not used.
+    */
+    bool DoMapped(
+        const char* script, std::string* errstr = nullptr,
+        const std::function<bool(uint32_t, const LuaObject&)>& callback = {});
+
+    /*
+      compiles `len` bytes of `buf`, which can be source code or a precompiled
+      chunk and need not be null-terminated, to a function without running
+      it. returns a nil object if it fails.
+    */
+    LuaFunction LoadBuffer(const char* buf, uint64_t len,
+                           const char* chunkname,
+                           std::string* errstr = nullptr);
+
+    /*
+      reader for `Load()` and `DoStream()`, which returns the next piece of
+      the chunk and sets its size, or returns nullptr or sets size to 0 at the
+      end. the piece must be valid until the next call. it must not throw.
+    */
+    typedef std::function<const char*(size_t* size)> ChunkReader;
+
+    /*
+      compiles a chunk, which can be source code or a precompiled chunk, to a
+      function while reading it piece by piece. returns a nil object if it
+      fails, including an istream broken while being read.
+    */
+    LuaFunction Load(const ChunkReader& reader, const char* chunkname,
+                     std::string* errstr = nullptr);
+    LuaFunction Load(std::istream& is, const char* chunkname,
+                     std::string* errstr = nullptr);
+
+    // same as `DoString()`, except that the chunk is read like `Load()`
+    bool DoStream(
+        const ChunkReader& reader, const char* chunkname,
+        std::string* errstr = nullptr,
+        const std::function<bool(uint32_t, const LuaObject&)>& callback = {});
+    bool DoStream(
+        std::istream& is, const char* chunkname, std::string* errstr = nullptr,
+        const std::function<bool(uint32_t, const LuaObject&)>& callback = {});
+
+    /*
+      makes `DoString()` keep functions compiled from at most `max_chunks`
+      chunks, and reuse them for identical chunks. 0 disables the cache, which
+      is the default.
+    */
+    void SetChunkCacheSize(uint32_t max_chunks) {
+        m_chunk_cache.SetCapacity(m_l, max_chunks);
+    }
+
+    void GetChunkCacheStats(LuaChunkCache::Stats* stats) const {
+        m_chunk_cache.GetStats(stats);
+    }
+
+    /*
+      makes `DoFile()` save compiled chunks in `dir` and load them instead of
+      compiling scripts again if scripts are not modified. `dir` must be a
+      private directory of the current user, otherwise false is returned and
+      the cache is disabled. nullptr or an empty string disables the cache.
+    */
+    bool SetBytecodeCacheDir(const char* dir, std::string* errstr = nullptr);
+
+    // ----- gc control ----- //
+
+    void GcCollect() {
+        lua_gc(m_l, LUA_GCCOLLECT, 0);
+    }
+    void GcStop() {
+        lua_gc(m_l, LUA_GCSTOP, 0);
+    }
+    void GcRestart() {
+        lua_gc(m_l, LUA_GCRESTART, 0);
+    }
+    bool GcIsRunning() const {
+        return lua_gc(m_l, LUA_GCISRUNNING, 0);
+    }
+
+    // returns the number of bytes in use
+    uint64_t GetMemoryUsage() const {
+        return (uint64_t)lua_gc(m_l, LUA_GCCOUNT, 0) * 1024 +
+            lua_gc(m_l, LUA_GCCOUNTB, 0);
+    }
+
+    // set parameters of the incremental mode and return previous values
+    int GcSetPause(int pause) {
+        return lua_gc(m_l, LUA_GCSETPAUSE, pause);
+    }
+    int GcSetStepMul(int stepmul) {
+        return lua_gc(m_l, LUA_GCSETSTEPMUL, stepmul);
+    }
+
+#if LUA_VERSION_NUM >= 504
+    /*
+      switch the collector to generational or incremental mode and return the
+      previous mode(`LUA_GCGEN` or `LUA_GCINC`). 0 keeps the current value of
+      a parameter.
+    */
+    int GcSetGenerational(int minormul = 0, int majormul = 0) {
+        return lua_gc(m_l, LUA_GCGEN, minormul, majormul);
+    }
+    int GcSetIncremental(int pause = 0, int stepmul = 0, int stepsize = 0) {
+        return lua_gc(m_l, LUA_GCINC, pause, stepmul, stepsize);
+    }
+#endif
+
+    /*
+      performs basic gc steps until `budget` runs out or a cycle is finished,
+      and returns true in the latter case. it works even if the collector is
+      stopped, e.g. to move gc work to idle time. in generational mode every
+      step is a whole minor collection.
+    */
+    bool GcStepFor(std::chrono::microseconds budget);
+
+    // calls the global function `name` like `LuaFunction::Call()`
+    template <typename... R, typename... Argv>
+    bool Call(const char* name, std::tuple<R...>* results,
+              std::string* errstr, Argv&&... argv) {
+        lua_getglobal(m_l, name);
+        PushValues(m_l, std::forward<Argv>(argv)...);
+        return CallFunction(m_l, sizeof...(Argv), results, errstr);
+    }
+
 private:
     template <typename T>
-    T GenericGetObject(const char* name) const {
+    T GenericGetObject(const char* name,
+                       LuaScope* scope = nullptr) const {
         lua_getglobal(m_l, name);
-        T ret(m_l, -1);
+        T ret(m_l, -1, scope);
         lua_pop(m_l, 1);
         return ret;
     }
 
+    template <typename T>
+    T GenericGetObject(const LuaKey& key,
+                       LuaScope* scope = nullptr) const {
+        PushRawGlobal(key);
+        T ret(m_l, -1, scope);
+        lua_pop(m_l, 2);
+        return ret;
+    }
+
+    template <typename T>
+    T GenericGetObject(const LuaPath& path,
+                       LuaScope* scope = nullptr) const {
+        PushPathValue(path);
+        T ret(m_l, -1, scope);
+        lua_pop(m_l, 2);
+        return ret;
+    }
+
+    // pushes the global table and the value of `key` in it
+    void PushRawGlobal(const LuaKey& key) const {
+        lua_rawgeti(m_l, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+        PushValue(m_l, key);
+        lua_rawget(m_l, -2);
+    }
+
+    // pushes the global table and the value of `path` starting from it
+    void PushPathValue(const LuaPath& path) const {
+        lua_rawgeti(m_l, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+        path.PushValue(m_l, -1);
+    }
+
 private:
     lua_State* m_l;
     void (*m_deleter)(lua_State*);
+    LuaAllocator* m_allocator; // destroyed after `m_l` is closed
 
     // metatable(only contains __gc) for DestructorObject
     int m_gc_table_ref;
+
+    // metatable(only contains __gc) for `PropertyWrapperBase`
+    int m_property_metatable_ref;
+
+    std::string m_bytecode_cache_dir; // empty if the cache is disabled
+    LuaChunkCache m_chunk_cache; // used by `DoString()`
 };
 
 }
@@ -3,13 +3,82 @@
 
 #include "lua_object.h"
 #include "lua_function.h"
+#include "lua_key.h"
+#include "lua_path.h"
+#include <vector>
 #include <functional>
 
 namespace luacpp {
 
 class LuaTable final : public LuaRefObject {
 public:
-    LuaTable(lua_State* l, int index) : LuaRefObject(l, index) {}
+    /*
+      keeps a table on the stack during its lifetime, so that getters and
+      setters(inherited from `LuaStackTable`) do not fetch the table from the
+      registry for every access. cursors MUST be destroyed in the reverse
+      order of their creation, and the stack is restored to the state before
+      the table was pinned when a cursor is destroyed.
+    */
+    class Cursor final : public LuaStackTable {
+    public:
+        Cursor(Cursor&& rhs) : LuaStackTable(rhs.m_l, rhs.m_index) {
+            rhs.m_l = nullptr;
+        }
+        Cursor(const Cursor&) = delete;
+        Cursor& operator=(const Cursor&) = delete;
+        Cursor& operator=(Cursor&&) = delete;
+
+        ~Cursor() {
+            // m_l is nullptr if this cursor was moved to another one
+            if (m_l) {
+                lua_settop(m_l, m_index - 1);
+            }
+        }
+
+        // returns false if the pinned value is not a table
+        bool IsValid() const {
+            return (GetType() == LUA_TTABLE);
+        }
+
+        /*
+          pins the subtable at `index` or associated with `name`/`key`. a nil
+          is pinned instead if the value is not a table, and the returned
+          cursor is invalid. getters and setters MUST NOT be called on an
+          invalid cursor.
+        */
+        Cursor PinTable(int index) const {
+            lua_rawgeti(m_l, m_index, index);
+            return PinTop(m_l);
+        }
+        Cursor PinTable(const char* name) const {
+            lua_getfield(m_l, m_index, name);
+            return PinTop(m_l);
+        }
+        Cursor PinTable(const LuaKey& key) const {
+            PushValue(m_l, key);
+            lua_rawget(m_l, m_index);
+            return PinTop(m_l);
+        }
+
+    private:
+        friend class LuaTable;
+
+        // pins the table on the top of the stack
+        Cursor(lua_State* l) : LuaStackTable(l, -1) {}
+
+        // same as the rule of `LuaPath::PushValue()`
+        static Cursor PinTop(lua_State* l) {
+            if (lua_type(l, -1) != LUA_TTABLE) {
+                lua_pop(l, 1);
+                lua_pushnil(l);
+            }
+            return Cursor(l);
+        }
+    };
+
+public:
+    LuaTable(lua_State* l, int index, LuaScope* scope = nullptr)
+        : LuaRefObject(l, index, scope) {}
     LuaTable(LuaObject&& lobj) : LuaRefObject(std::move(lobj)) {}
     LuaTable(const LuaObject& lobj) : LuaRefObject(lobj) {}
     LuaTable(LuaTable&&) = default;
@@ -26,6 +95,12 @@ public:
     LuaObject Get(const char* name) const {
         return GenericGetObject<LuaObject>(name);
     }
+    LuaObject Get(const LuaKey& key) const {
+        return GenericGetObject<LuaObject>(key);
+    }
+    LuaObject Get(const LuaPath& path) const {
+        return GenericGetObject<LuaObject>(path);
+    }
 
     LuaTable GetTable(int index) const {
         return GenericGetObject<LuaTable>(index);
@@ -33,6 +108,12 @@ public:
     LuaTable GetTable(const char* name) const {
         return GenericGetObject<LuaTable>(name);
     }
+    LuaTable GetTable(const LuaKey& key) const {
+        return GenericGetObject<LuaTable>(key);
+    }
+    LuaTable GetTable(const LuaPath& path) const {
+        return GenericGetObject<LuaTable>(path);
+    }
 
     LuaFunction GetFunction(int index) const {
         return GenericGetObject<LuaFunction>(index);
@@ -40,6 +121,12 @@ public:
     LuaFunction GetFunction(const char* name) const {
         return GenericGetObject<LuaFunction>(name);
     }
+    LuaFunction GetFunction(const LuaKey& key) const {
+        return GenericGetObject<LuaFunction>(key);
+    }
+    LuaFunction GetFunction(const LuaPath& path) const {
+        return GenericGetObject<LuaFunction>(path);
+    }
 
     template <typename T>
     LuaClass<T> GetClass(int index) const {
@@ -51,42 +138,73 @@ public:
         return GenericGetObject<LuaClass<T>>(name);
     }
 
+    template <typename T>
+    LuaClass<T> GetClass(const LuaKey& key) const {
+        return GenericGetObject<LuaClass<T>>(key);
+    }
+
+    template <typename T>
+    LuaClass<T> GetClass(const LuaPath& path) const {
+        return GenericGetObject<LuaClass<T>>(path);
+    }
+
     LuaStringRef GetStringRef(int index) const;
     LuaStringRef GetStringRef(const char* name) const;
+    LuaStringRef GetStringRef(const LuaKey& key) const;
+    LuaStringRef GetStringRef(const LuaPath& path) const;
 
     const char* GetString(int index) const;
     const char* GetString(const char* name) const;
+    const char* GetString(const LuaKey& key) const;
+    const char* GetString(const LuaPath& path) const;
 
     lua_Number GetNumber(int index) const;
     lua_Number GetNumber(const char* name) const;
+    lua_Number GetNumber(const LuaKey& key) const;
+    lua_Number GetNumber(const LuaPath& path) const;
 
     lua_Integer GetInteger(int index) const;
     lua_Integer GetInteger(const char* name) const;
+    lua_Integer GetInteger(const LuaKey& key) const;
+    lua_Integer GetInteger(const LuaPath& path) const;
 
     void* GetPointer(int index) const;
     void* GetPointer(const char* name) const;
+    void* GetPointer(const LuaKey& key) const;
+    void* GetPointer(const LuaPath& path) const;
 
     // ----- setters ----- //
 
     void Set(int index, const LuaRefObject& lobj);
     void Set(const char* name, const LuaRefObject& lobj);
+    void Set(const LuaKey& key, const LuaRefObject& lobj);
 
     void SetString(int index, const char* str);
     void SetString(int index, const char* str, uint64_t len);
     void SetString(const char* name, const char* str);
     void SetString(const char* name, const char* str, uint64_t len);
+    void SetString(const LuaKey& key, const char* str);
+    void SetString(const LuaKey& key, const char* str, uint64_t len);
 
     void SetNumber(int index, lua_Number);
     void SetNumber(const char* name, lua_Number);
+    void SetNumber(const LuaKey& key, lua_Number);
 
     void SetInteger(int index, lua_Integer);
     void SetInteger(const char* name, lua_Integer);
+    void SetInteger(const LuaKey& key, lua_Integer);
 
     void SetPointer(int index, void*);
     void SetPointer(const char* name, void*);
+    void SetPointer(const LuaKey& key, void*);
 
     // ----- //
 
+    Cursor Pin() const {
+        PushSelf();
+        return Cursor(m_l);
+    }
+
     uint64_t GetSize() const {
         PushSelf();
         auto len = lua_rawlen(m_l, -1);
@@ -94,73 +212,117 @@ public:
         return len;
     }
 
+    /*
+      copies at most `n` elements of the array part to `buf` and returns the
+      number of elements copied. `T` can be any type that arguments of
+      exported functions can be. Note that strings referenced by `const char*`
+      or `LuaStringRef` are valid only when they are still in this table.
+    */
+    template <typename T>
+    uint64_t CopyTo(T* buf, uint64_t n) const {
+        PushSelf();
+        uint64_t len = lua_rawlen(m_l, -1);
+        if (n > len) {
+            n = len;
+        }
+        for (uint64_t i = 0; i < n; ++i) {
+            lua_rawgeti(m_l, -1, i + 1);
+            T value = ValueConverter(m_l, -1);
+            buf[i] = std::move(value);
+            lua_pop(m_l, 1);
+        }
+        lua_pop(m_l, 1);
+        return n;
+    }
+
+    // returns all elements of the array part. see `CopyTo()`.
+    template <typename T>
+    std::vector<T> ToVector() const {
+        std::vector<T> ret;
+
+        PushSelf();
+        uint64_t len = lua_rawlen(m_l, -1);
+        ret.reserve(len);
+        for (uint64_t i = 0; i < len; ++i) {
+            lua_rawgeti(m_l, -1, i + 1);
+            T value = ValueConverter(m_l, -1);
+            ret.push_back(std::move(value));
+            lua_pop(m_l, 1);
+        }
+        lua_pop(m_l, 1);
+
+        return ret;
+    }
+
+    /*
+      `f` is one of the following:
+        - (uint32_t i, ValueType value) -> bool, iterating the array part. `i`
+          starts from 0.
+        - (KeyType key, ValueType value) -> bool, iterating all key-value
+          pairs.
+      `KeyType` and `ValueType` can be builtin types or any type that
+      arguments of exported functions can be, which are converted from the
+      stack directly. returns false if `f` returns false.
+    */
     template <typename FuncType>
     bool ForEach(FuncType&& f) const {
-        using RealFuncType = typename std::remove_reference<FuncType>::type;
-        typename FunctionTraits<RealFuncType>::std_function_type func(
-            std::forward<FuncType>(f));
-        return DoForEach(func);
+        PushSelf();
+        bool ok = IterateTable(m_l, -1, f);
+        lua_pop(m_l, 1);
+        return ok;
     }
 
 private:
+    friend class LuaScope;
+
     template <typename T>
-    T GenericGetObject(int index) const {
+    T GenericGetObject(int index, LuaScope* scope = nullptr) const {
         PushSelf();
         lua_rawgeti(m_l, -1, index);
-        T ret(m_l, -1);
+        T ret(m_l, -1, scope);
         lua_pop(m_l, 2);
         return ret;
     }
 
     template <typename T>
-    T GenericGetObject(const char* name) const {
+    T GenericGetObject(const char* name,
+                       LuaScope* scope = nullptr) const {
         PushSelf();
         lua_getfield(m_l, -1, name);
-        T ret(m_l, -1);
+        T ret(m_l, -1, scope);
         lua_pop(m_l, 2);
         return ret;
     }
 
     template <typename T>
-    bool DoForEach(const std::function<bool(uint32_t i /* starting from 0 */,
-                                            const T& value)>& func) const {
-        BuiltInTypeAssert<T>();
-
-        PushSelf();
-        auto len = lua_rawlen(m_l, -1);
-
-        for (uint32_t i = 0; i < len; ++i) {
-            lua_rawgeti(m_l, -1, i + 1);
-            if (!func(i, T(m_l, -1))) {
-                lua_pop(m_l, 2);
-                return false;
-            }
-            lua_pop(m_l, 1);
-        }
-
-        lua_pop(m_l, 1);
-        return true;
+    T GenericGetObject(const LuaKey& key,
+                       LuaScope* scope = nullptr) const {
+        PushRawField(key);
+        T ret(m_l, -1, scope);
+        lua_pop(m_l, 2);
+        return ret;
     }
 
-    template <typename T1, typename T2>
-    bool DoForEach(
-        const std::function<bool(const T1& key, const T2& value)>& func) const {
-        BuiltInTypeAssert<T1>();
-        BuiltInTypeAssert<T2>();
+    template <typename T>
+    T GenericGetObject(const LuaPath& path,
+                       LuaScope* scope = nullptr) const {
+        PushPathValue(path);
+        T ret(m_l, -1, scope);
+        lua_pop(m_l, 2);
+        return ret;
+    }
 
+    // pushes this table and the value of `key` in it
+    void PushRawField(const LuaKey& key) const {
         PushSelf();
-        lua_pushnil(m_l);
-        while (lua_next(m_l, -2) != 0) {
-            if (!func(T1(m_l, -2), T2(m_l, -1))) {
-                lua_pop(m_l, 3);
-                return false;
-            }
-
-            lua_pop(m_l, 1);
-        }
-        lua_pop(m_l, 1);
+        PushValue(m_l, key);
+        lua_rawget(m_l, -2);
+    }
 
-        return true;
+    // pushes this table and the value of `path` starting from it
+    void PushPathValue(const LuaPath& path) const {
+        PushSelf();
+        path.PushValue(m_l, -1);
     }
 };
 
@@ -2,9 +2,17 @@
 #define __LUA_CPP_LUACPP_H__
 
 #include "lua_object.h"
+#include "lua_key.h"
+#include "lua_path.h"
 #include "lua_table.h"
+#include "lua_stack_object.h"
+#include "lua_stack_table.h"
 #include "lua_function.h"
 #include "lua_class.h"
 #include "lua_state.h"
+#include "lua_scope.h"
+#include "lua_slab_allocator.h"
+#include "lua_memory_limit_allocator.h"
+#include "lua_arena_allocator.h"
 
 #endif
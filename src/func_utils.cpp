@@ -1,6 +1,7 @@
 #include "luacpp/func_utils.h"
 #include "luacpp/lua_table.h"
 #include "luacpp/lua_function.h"
+#include "luacpp/lua_key.h"
 
 namespace luacpp {
 
@@ -16,20 +17,34 @@ ValueConverter::operator LuaFunction() const {
     return LuaFunction(m_l, m_index);
 }
 
+int TracebackMessageHandler(lua_State* l) {
+    const char* msg = lua_tostring(l, 1);
+    if (!msg) {
+        msg = lua_pushfstring(l, "(error object is a %s value)",
+                              luaL_typename(l, 1));
+    }
+    luaL_traceback(l, l, msg, 1);
+    return 1;
+}
+
 void PushValue(lua_State* l, const LuaRefObject& obj) {
-    lua_rawgeti(l, LUA_REGISTRYINDEX, obj.GetRefIndex());
+    obj.PushTo(l);
 }
 
 void PushValue(lua_State* l, const LuaObject& obj) {
-    lua_rawgeti(l, LUA_REGISTRYINDEX, obj.GetRefIndex());
+    obj.PushTo(l);
 }
 
 void PushValue(lua_State* l, const LuaTable& tbl) {
-    lua_rawgeti(l, LUA_REGISTRYINDEX, tbl.GetRefIndex());
+    tbl.PushTo(l);
 }
 
 void PushValue(lua_State* l, const LuaFunction& func) {
-    lua_rawgeti(l, LUA_REGISTRYINDEX, func.GetRefIndex());
+    func.PushTo(l);
+}
+
+void PushValue(lua_State* l, const LuaKey& key) {
+    key.PushTo(l);
 }
 
 }
@@ -0,0 +1,214 @@
+#include "luacpp/lua_arena_allocator.h"
+#include <stdlib.h>
+#include <string.h>
+using namespace std;
+
+namespace luacpp {
+
+static constexpr size_t BLOCK_ALIGNMENT = 16;
+
+// blocks larger than this are allocated by `malloc()`
+static constexpr size_t LARGE_BLOCK_SIZE = 4096;
+
+static constexpr size_t MIN_CHUNK_SIZE = 4 * LARGE_BLOCK_SIZE;
+static constexpr size_t MAX_CHUNK_SIZE = 16 * 1024 * 1024;
+
+// keeps blocks after the header aligned
+static constexpr size_t CHUNK_HEADER_SIZE = BLOCK_ALIGNMENT;
+
+static inline size_t AlignSize(size_t size) {
+    return (size + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1);
+}
+
+/*
+  large blocks reserve a chunk header in front of them, so that a large block
+  can be turned into a chunk in place if shrinking it cannot allocate a block.
+*/
+static inline void* MallocLarge(size_t size) {
+    auto p = (char*)malloc(CHUNK_HEADER_SIZE + size);
+    return p ? p + CHUNK_HEADER_SIZE : nullptr;
+}
+
+static inline void* ReallocLarge(void* ptr, size_t size) {
+    auto p = (char*)realloc((char*)ptr - CHUNK_HEADER_SIZE,
+                            CHUNK_HEADER_SIZE + size);
+    return p ? p + CHUNK_HEADER_SIZE : nullptr;
+}
+
+static inline void FreeLarge(void* ptr) {
+    free((char*)ptr - CHUNK_HEADER_SIZE);
+}
+
+LuaArenaAllocator::LuaArenaAllocator(size_t chunk_size)
+    : LuaAllocator(Alloc), m_chunks(nullptr), m_chunk_num(0), m_cur(nullptr),
+      m_end(nullptr), m_last_block(nullptr), m_chunk_bytes(0),
+      m_used_bytes(0), m_large_blocks(0), m_large_bytes(0) {
+    static_assert(sizeof(ChunkHeader) <= CHUNK_HEADER_SIZE,
+                  "chunk header is too large");
+
+    if (chunk_size < MIN_CHUNK_SIZE) {
+        chunk_size = MIN_CHUNK_SIZE;
+    }
+    m_next_chunk_size = AlignSize(chunk_size);
+}
+
+LuaArenaAllocator::~LuaArenaAllocator() {
+    while (m_chunks) {
+        auto next = m_chunks->next;
+        free(m_chunks);
+        m_chunks = next;
+    }
+}
+
+bool LuaArenaAllocator::AddChunk(size_t min_size) {
+    size_t size = m_next_chunk_size;
+    while (size < min_size) {
+        size *= 2;
+    }
+
+    // links chunks without containers, which may throw inside lua
+    auto header = (ChunkHeader*)malloc(CHUNK_HEADER_SIZE + size);
+    if (!header) {
+        return false;
+    }
+    header->next = m_chunks;
+    m_chunks = header;
+    ++m_chunk_num;
+    m_chunk_bytes += CHUNK_HEADER_SIZE + size;
+    m_cur = (char*)header + CHUNK_HEADER_SIZE;
+    m_end = m_cur + size;
+    m_last_block = nullptr;
+
+    if (size < MAX_CHUNK_SIZE) {
+        m_next_chunk_size = size * 2;
+    }
+    return true;
+}
+
+void* LuaArenaAllocator::AllocSmall(size_t size) {
+    size = AlignSize(size);
+    if ((size_t)(m_end - m_cur) < size) {
+        if (!AddChunk(size)) {
+            return nullptr;
+        }
+    }
+
+    m_last_block = m_cur;
+    m_cur += size;
+    m_used_bytes += size;
+    return m_last_block;
+}
+
+void* LuaArenaAllocator::AllocLarge(size_t size) {
+    auto ret = MallocLarge(size);
+    if (ret) {
+        ++m_large_blocks;
+        m_large_bytes += size;
+    }
+    return ret;
+}
+
+/*
+  keeps a large block as a small one when shrinking it cannot allocate a
+  block. the block becomes a full chunk using its reserved header and is
+  released with other chunks.
+*/
+void* LuaArenaAllocator::KeepLarge(void* ptr, size_t osize, size_t nsize) {
+    auto header = (ChunkHeader*)((char*)ptr - CHUNK_HEADER_SIZE);
+    header->next = m_chunks;
+    m_chunks = header;
+    ++m_chunk_num;
+    m_chunk_bytes += CHUNK_HEADER_SIZE + osize;
+    m_used_bytes += AlignSize(nsize);
+    --m_large_blocks;
+    m_large_bytes -= osize;
+    return ptr;
+}
+
+// `osize` is 0 if `ptr` is nullptr
+void* LuaArenaAllocator::Realloc(void* ptr, size_t osize, size_t nsize) {
+    if (osize > LARGE_BLOCK_SIZE) {
+        if (nsize > LARGE_BLOCK_SIZE) {
+            auto ret = ReallocLarge(ptr, nsize);
+            if (ret) {
+                m_large_bytes = m_large_bytes - osize + nsize;
+            } else if (nsize <= osize) {
+                // lua 5.2 and 5.3 assume that shrinking never fails
+                m_large_bytes = m_large_bytes - osize + nsize;
+                ret = ptr;
+            }
+            return ret;
+        }
+
+        auto ret = AllocSmall(nsize);
+        if (ret) {
+            memcpy(ret, ptr, nsize);
+            --m_large_blocks;
+            m_large_bytes -= osize;
+            FreeLarge(ptr);
+        } else {
+            ret = KeepLarge(ptr, osize, nsize);
+        }
+        return ret;
+    }
+
+    if (nsize > LARGE_BLOCK_SIZE) {
+        auto ret = AllocLarge(nsize);
+        if (ret && ptr) {
+            memcpy(ret, ptr, osize);
+        }
+        return ret;
+    }
+
+    const size_t old_size = AlignSize(osize);
+    if (nsize <= old_size) {
+        return ptr ? ptr : AllocSmall(nsize);
+    }
+
+    // the latest block grows in place if there is enough space
+    const size_t new_size = AlignSize(nsize);
+    if (ptr && ptr == m_last_block &&
+        (size_t)(m_end - m_last_block) >= new_size) {
+        m_cur = m_last_block + new_size;
+        m_used_bytes += new_size - old_size;
+        return ptr;
+    }
+
+    auto ret = AllocSmall(nsize);
+    if (ret && ptr) {
+        memcpy(ret, ptr, osize);
+    }
+    return ret;
+}
+
+void* LuaArenaAllocator::Alloc(void* ud, void* ptr, size_t osize,
+                               size_t nsize) {
+    auto allocator = (LuaArenaAllocator*)ud;
+
+    // `osize` is the type of object being allocated if `ptr` is nullptr
+    if (!ptr) {
+        osize = 0;
+    }
+
+    if (nsize == 0) {
+        // small blocks are released with chunks
+        if (osize > LARGE_BLOCK_SIZE) {
+            --allocator->m_large_blocks;
+            allocator->m_large_bytes -= osize;
+            FreeLarge(ptr);
+        }
+        return nullptr;
+    }
+
+    return allocator->Realloc(ptr, osize, nsize);
+}
+
+void LuaArenaAllocator::GetStats(Stats* stats) const {
+    stats->chunk_num = m_chunk_num;
+    stats->chunk_bytes = m_chunk_bytes;
+    stats->used_bytes = m_used_bytes;
+    stats->large_blocks = m_large_blocks;
+    stats->large_bytes = m_large_bytes;
+}
+
+}
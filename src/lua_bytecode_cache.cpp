@@ -0,0 +1,272 @@
+#include "luacpp/lua_bytecode_cache.h"
+#include "luacpp/lua_52_53.h"
+#include "luacpp/lua_hash.h"
+extern "C" {
+#include "lauxlib.h"
+}
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <atomic>
+using namespace std;
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace luacpp {
+
+/*
+  the last byte is the version of the format, which MUST be bumped whenever
+  the layout or the hash function changes. version 2 uses the word-wise
+  FNV-1a of `HashBytes()` instead of the byte-wise one for file names and
+  hashes in headers.
+*/
+static const char CACHE_MAGIC[8] = {'L', 'U', 'A', 'C', 'P', 'P', 'B', '2'};
+
+// followed by the path of the script and the compiled chunk
+struct CacheHeader final {
+    char magic[8];
+    uint32_t lua_version_num;
+    uint32_t path_len;
+    int64_t mtime;
+    uint64_t source_size;
+    uint64_t source_hash;
+    uint64_t bytecode_size;
+    uint64_t bytecode_hash;
+};
+
+static bool ReadFile(const char* fpath, string* content) {
+    FILE* fp = fopen(fpath, "rb");
+    if (!fp) {
+        return false;
+    }
+
+    char buf[16384];
+    while (true) {
+        auto n = fread(buf, 1, sizeof(buf), fp);
+        if (n == 0) {
+            break;
+        }
+        content->append(buf, n);
+    }
+
+    bool ok = !ferror(fp);
+    fclose(fp);
+    return ok;
+}
+
+const char* SkipComment(const char* data, uint64_t* len) {
+    if (*len >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        data += 3;
+        *len -= 3;
+    }
+
+    if (*len == 0 || data[0] != '#') {
+        return data;
+    }
+
+    auto end = (const char*)memchr(data, '\n', *len);
+    if (!end) {
+        end = data + *len;
+        *len = 0;
+        return end;
+    }
+
+    if (end + 1 < data + *len && end[1] == LUA_SIGNATURE[0]) {
+        ++end; // precompiled chunk
+    }
+    *len -= (end - data);
+    return end;
+}
+
+// sequence of temporary files written by this process
+static atomic<uint32_t> g_tmp_file_seq(0);
+
+/*
+  writes to a temporary file first so that readers never see partial files.
+  temporary files are named by the process id and a sequence number, so that
+  processes or threads saving the same script do not write the same file.
+*/
+static void WriteFile(const string& fpath, const string& content) {
+    auto tmp_path = fpath + "." + to_string(getpid()) + "." +
+        to_string(g_tmp_file_seq.fetch_add(1)) + ".tmp";
+    FILE* fp = fopen(tmp_path.c_str(), "wb");
+    if (!fp) {
+        return;
+    }
+
+    bool ok = (fwrite(content.data(), 1, content.size(), fp) ==
+               content.size());
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(), fpath.c_str()) != 0) {
+        remove(tmp_path.c_str());
+    }
+}
+
+static string GetCachePath(const char* cache_dir, const char* script) {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.luac",
+             (unsigned long long)HashBytes(script, strlen(script)));
+    return string(cache_dir) + name;
+}
+
+/*
+  `source_hash` of `expected` is computed only if other fields match the cache
+  file, in which case the source is read into `source` and `*source_read` is
+  set to true.
+*/
+static bool LoadCache(lua_State* l, const string& cache_path,
+                      CacheHeader* expected, const char* script,
+                      string* source, bool* source_read) {
+    string content;
+    if (!ReadFile(cache_path.c_str(), &content) ||
+        content.size() < sizeof(CacheHeader)) {
+        return false;
+    }
+
+    CacheHeader header;
+    memcpy(&header, content.data(), sizeof(CacheHeader));
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.lua_version_num != expected->lua_version_num ||
+        header.path_len != expected->path_len ||
+        header.mtime != expected->mtime ||
+        header.source_size != expected->source_size ||
+        content.size() !=
+            sizeof(CacheHeader) + header.path_len + header.bytecode_size) {
+        return false;
+    }
+
+    const char* path = content.data() + sizeof(CacheHeader);
+    if (memcmp(path, script, header.path_len) != 0) {
+        return false;
+    }
+
+    *source_read = ReadFile(script, source);
+    if (!*source_read) {
+        return false;
+    }
+    expected->source_size = source->size();
+    expected->source_hash = HashBytes(source->data(), source->size());
+    if (header.source_size != expected->source_size ||
+        header.source_hash != expected->source_hash) {
+        return false;
+    }
+
+    const char* bytecode = path + header.path_len;
+    if (HashBytes(bytecode, header.bytecode_size) != header.bytecode_hash) {
+        return false;
+    }
+
+    string chunkname = string("@") + script;
+    if (luaL_loadbufferx(l, bytecode, header.bytecode_size, chunkname.c_str(),
+                         "b") != LUA_OK) {
+        lua_pop(l, 1);
+        return false;
+    }
+    return true;
+}
+
+static int Writer(lua_State*, const void* p, size_t sz, void* ud) {
+    ((string*)ud)->append((const char*)p, sz);
+    return 0;
+}
+
+// dumps the function on the top of the stack
+static void SaveCache(lua_State* l, const string& cache_path,
+                      CacheHeader header, const char* script) {
+    string bytecode;
+    if (lua_dump(l, Writer, &bytecode, 0) != 0) {
+        return;
+    }
+
+    header.bytecode_size = bytecode.size();
+    header.bytecode_hash = HashBytes(bytecode.data(), bytecode.size());
+
+    string content;
+    content.reserve(sizeof(CacheHeader) + header.path_len + bytecode.size());
+    content.append((const char*)&header, sizeof(CacheHeader));
+    content.append(script, header.path_len);
+    content.append(bytecode);
+    WriteFile(cache_path, content);
+}
+
+bool CheckBytecodeCacheDir(const char* dir, string* errstr) {
+    struct stat st;
+    if (stat(dir, &st) != 0) {
+        if (errstr) {
+            *errstr = string("cannot stat ") + dir + ": " + strerror(errno);
+        }
+        return false;
+    }
+    if ((st.st_mode & S_IFMT) != S_IFDIR) {
+        if (errstr) {
+            *errstr = string(dir) + " is not a directory";
+        }
+        return false;
+    }
+#ifndef _WIN32
+    if (st.st_uid != geteuid()) {
+        if (errstr) {
+            *errstr = string(dir) + " is not owned by the current user";
+        }
+        return false;
+    }
+    if (st.st_mode & (S_IWGRP | S_IWOTH)) {
+        if (errstr) {
+            *errstr = string(dir) + " is writable by group or others";
+        }
+        return false;
+    }
+#endif
+    return true;
+}
+
+int LoadFileWithBytecodeCache(lua_State* l, const char* script,
+                              const char* cache_dir) {
+    struct stat st;
+    if (stat(script, &st) != 0) {
+        return luaL_loadfile(l, script);
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.lua_version_num = LUA_VERSION_NUM;
+    header.path_len = strlen(script);
+    header.mtime = st.st_mtime;
+    header.source_size = st.st_size;
+
+    string source;
+    bool source_read = false;
+    auto cache_path = GetCachePath(cache_dir, script);
+    if (LoadCache(l, cache_path, &header, script, &source, &source_read)) {
+        return LUA_OK;
+    }
+
+    if (!source_read) {
+        if (!ReadFile(script, &source)) {
+            return luaL_loadfile(l, script);
+        }
+        header.source_size = source.size();
+        header.source_hash = HashBytes(source.data(), source.size());
+    }
+
+    // compiles what is hashed instead of reading `script` again
+    uint64_t len = source.size();
+    const char* data = SkipComment(source.data(), &len);
+    const char* mode = (len > 0 && data[0] == LUA_SIGNATURE[0]) ? "b" : "t";
+    string chunkname = string("@") + script;
+    int ret = luaL_loadbufferx(l, data, len, chunkname.c_str(), mode);
+    if (ret == LUA_OK) {
+        SaveCache(l, cache_path, header, script);
+    }
+    return ret;
+}
+
+}
@@ -0,0 +1,82 @@
+#include "luacpp/lua_chunk_cache.h"
+#include "luacpp/lua_hash.h"
+extern "C" {
+#include "lauxlib.h"
+}
+#include <string.h>
+using namespace std;
+
+namespace luacpp {
+
+void LuaChunkCache::RemoveLast(lua_State* l) {
+    auto& entry = m_entries.back();
+    luaL_unref(l, LUA_REGISTRYINDEX, entry.ref);
+    m_index.erase(entry.hash);
+    m_entries.pop_back();
+}
+
+void LuaChunkCache::SetCapacity(lua_State* l, uint32_t cap) {
+    m_capacity = cap;
+    while (m_entries.size() > cap) {
+        RemoveLast(l);
+    }
+}
+
+void LuaChunkCache::Clear(lua_State* l) {
+    for (auto& entry : m_entries) {
+        luaL_unref(l, LUA_REGISTRYINDEX, entry.ref);
+    }
+    m_entries.clear();
+    m_index.clear();
+}
+
+int LuaChunkCache::Load(lua_State* l, const char* chunk) {
+    const size_t len = strlen(chunk);
+    const uint64_t hash = HashBytes(chunk, len);
+
+    auto it = m_index.find(hash);
+    if (it != m_index.end()) {
+        auto entry = it->second;
+        if (entry->chunk.size() == len &&
+            memcmp(entry->chunk.data(), chunk, len) == 0) {
+            ++m_hits;
+            m_entries.splice(m_entries.begin(), m_entries, entry);
+            lua_rawgeti(l, LUA_REGISTRYINDEX, entry->ref);
+            return LUA_OK;
+        }
+    }
+
+    ++m_misses;
+    int ret = luaL_loadstring(l, chunk);
+    if (ret != LUA_OK || m_capacity == 0) {
+        return ret;
+    }
+
+    // replaces the chunk with the same hash
+    if (it != m_index.end()) {
+        luaL_unref(l, LUA_REGISTRYINDEX, it->second->ref);
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    } else if (m_entries.size() >= m_capacity) {
+        RemoveLast(l);
+    }
+
+    lua_pushvalue(l, -1);
+    Entry entry;
+    entry.hash = hash;
+    entry.chunk.assign(chunk, len);
+    entry.ref = luaL_ref(l, LUA_REGISTRYINDEX);
+    m_entries.push_front(std::move(entry));
+    m_index[hash] = m_entries.begin();
+
+    return LUA_OK;
+}
+
+void LuaChunkCache::GetStats(Stats* stats) const {
+    stats->hits = m_hits;
+    stats->misses = m_misses;
+    stats->size = m_entries.size();
+    stats->capacity = m_capacity;
+}
+
+}
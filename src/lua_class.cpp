@@ -0,0 +1,98 @@
+#include "luacpp/lua_class.h"
+#include <string.h>
+
+namespace luacpp {
+
+void InvalidateClassLookupTable(lua_State* l, int idx) {
+    auto data = (LuaClassData*)lua_touserdata(l, idx);
+
+    // derived classes are always outdated if this class is outdated
+    if (data->lookup_table_outdated) {
+        return;
+    }
+    data->lookup_table_outdated = true;
+
+    // derived classes are keys of the table
+    luaL_checkstack(l, 3, "too many levels of derived classes");
+    lua_getiuservalue(l, idx, CLASS_CHILDREN_TABLE_IDX);
+    lua_pushnil(l);
+    while (lua_next(l, -2) != 0) {
+        lua_pop(l, 1);
+        InvalidateClassLookupTable(l, lua_gettop(l));
+    }
+    lua_pop(l, 1);
+}
+
+// metamethods of class and instance metatables are not members
+static bool IsInternalField(const char* key) {
+    return (strcmp(key, "__index") == 0 || strcmp(key, "__newindex") == 0 ||
+            strcmp(key, "__gc") == 0 || strcmp(key, "__call") == 0);
+}
+
+// copies fields of table at `src` that do not exist in table at `dst`
+static void MergeMissingFields(lua_State* l, int src, int dst) {
+    lua_pushnil(l);
+    while (lua_next(l, src) != 0) {
+        if (lua_type(l, -2) == LUA_TSTRING &&
+            !IsInternalField(lua_tostring(l, -2))) {
+            lua_pushvalue(l, -2);
+            lua_rawget(l, dst);
+            bool exists = !lua_isnil(l, -1);
+            lua_pop(l, 1);
+
+            if (!exists) {
+                lua_pushvalue(l, -2); // key
+                lua_pushvalue(l, -2); // value
+                lua_rawset(l, dst);
+            }
+        }
+        lua_pop(l, 1); // value
+    }
+}
+
+/*
+  members are searched in the following order, and the first one found is
+  used:
+
+  1. member functions and properties of this class
+  2. static members of this class
+  3. lookup tables of base classes in the order of being added
+*/
+static void RebuildClassLookupTable(lua_State* l, int idx) {
+    lua_newtable(l);
+    int lookup_idx = lua_gettop(l);
+
+    lua_getiuservalue(l, idx, CLASS_INSTANCE_METATABLE_IDX);
+    MergeMissingFields(l, lua_gettop(l), lookup_idx);
+    lua_pop(l, 1);
+
+    lua_getmetatable(l, idx);
+    MergeMissingFields(l, lua_gettop(l), lookup_idx);
+    lua_pop(l, 1);
+
+    lua_getiuservalue(l, idx, CLASS_PARENT_TABLE_IDX);
+    auto len = lua_rawlen(l, -1);
+    for (lua_Unsigned i = 1; i <= len; ++i) {
+        lua_rawgeti(l, -1, i);
+        PushClassLookupTable(l, lua_gettop(l));
+        MergeMissingFields(l, lua_gettop(l), lookup_idx);
+        lua_pop(l, 2);
+    }
+    lua_pop(l, 1);
+
+    lua_setiuservalue(l, idx, CLASS_LOOKUP_TABLE_IDX);
+}
+
+void PushClassLookupTable(lua_State* l, int idx) {
+    idx = lua_absindex(l, idx);
+
+    auto data = (LuaClassData*)lua_touserdata(l, idx);
+    if (data->lookup_table_outdated) {
+        RebuildClassLookupTable(l, idx);
+        data->lookup_table_outdated = false;
+    }
+
+    lua_getiuservalue(l, idx, CLASS_LOOKUP_TABLE_IDX);
+}
+
+}
@@ -0,0 +1,113 @@
+#include "luacpp/lua_memory_limit_allocator.h"
+#include <stdlib.h>
+
+namespace luacpp {
+
+LuaMemoryLimitAllocator::LuaMemoryLimitAllocator()
+    : LuaAllocator(Alloc), m_current(0), m_peak(0), m_soft_limit(0),
+      m_hard_limit(0), m_soft_limit_hits(0), m_threshold(UINT64_MAX),
+      m_soft_limit_armed(false), m_retrying(false), m_retry_ptr(nullptr),
+      m_retry_nsize(0) {}
+
+void LuaMemoryLimitAllocator::UpdateThreshold() {
+    m_threshold = UINT64_MAX;
+    if (m_soft_limit > 0) {
+        m_threshold = m_soft_limit;
+    }
+    if (m_hard_limit > 0 && m_hard_limit < m_threshold) {
+        m_threshold = m_hard_limit;
+    }
+}
+
+void LuaMemoryLimitAllocator::SetLimits(uint64_t soft_limit,
+                                        uint64_t hard_limit) {
+    m_soft_limit = soft_limit;
+    m_hard_limit = hard_limit;
+    m_soft_limit_armed = (soft_limit > 0 && m_current < soft_limit);
+    m_retrying = false;
+    UpdateThreshold();
+}
+
+bool LuaMemoryLimitAllocator::CheckLimits(void* ptr, size_t nsize,
+                                          uint64_t next, bool is_new_object) {
+    /*
+      only the retry of the failed request bypasses the soft limit. any other
+      growing allocation means that the request was given up, e.g. by
+      `luaL_Buffer`, so the bypass is cleared in both cases.
+    */
+    bool check_soft_limit = true;
+    if (m_retrying) {
+        check_soft_limit = (ptr != m_retry_ptr || nsize != m_retry_nsize);
+        m_retrying = false;
+        UpdateThreshold();
+    }
+
+    if (m_hard_limit > 0 && next > m_hard_limit) {
+        return false;
+    }
+
+    /*
+      lua runs a full gc and tries the same request again when an allocation
+      of a new object fails. other allocations, e.g. buffers of `luaL_Buffer`,
+      may raise an error immediately, so they never fail here. the threshold
+      is cleared so that the next growing allocation comes here.
+    */
+    if (is_new_object && check_soft_limit && m_soft_limit > 0 &&
+        next > m_soft_limit && m_soft_limit_armed) {
+        m_soft_limit_armed = false;
+        m_retrying = true;
+        m_retry_ptr = ptr;
+        m_retry_nsize = nsize;
+        m_threshold = 0;
+        ++m_soft_limit_hits;
+        return false;
+    }
+
+    return true;
+}
+
+void* LuaMemoryLimitAllocator::Alloc(void* ud, void* ptr, size_t osize,
+                                     size_t nsize) {
+    auto allocator = (LuaMemoryLimitAllocator*)ud;
+
+    // `osize` is the type of object being allocated if `ptr` is nullptr
+    const bool is_new_object = (!ptr && osize > 0);
+    if (!ptr) {
+        osize = 0;
+    }
+
+    if (nsize == 0) {
+        free(ptr);
+        allocator->m_current -= osize;
+        if (!allocator->m_soft_limit_armed &&
+            allocator->m_current < allocator->m_soft_limit) {
+            allocator->m_soft_limit_armed = true;
+        }
+        return nullptr;
+    }
+
+    const uint64_t next = allocator->m_current - osize + nsize;
+    if (next > allocator->m_threshold && nsize > osize &&
+        !allocator->CheckLimits(ptr, nsize, next, is_new_object)) {
+        return nullptr;
+    }
+
+    auto ret = realloc(ptr, nsize);
+    if (ret) {
+        allocator->m_current = next;
+        if (next > allocator->m_peak) {
+            allocator->m_peak = next;
+        }
+    }
+    return ret;
+}
+
+void LuaMemoryLimitAllocator::GetStats(Stats* stats) const {
+    stats->current_bytes = m_current;
+    stats->peak_bytes = m_peak;
+    stats->soft_limit = m_soft_limit;
+    stats->hard_limit = m_hard_limit;
+    stats->soft_limit_hits = m_soft_limit_hits;
+}
+
+}
@@ -1,12 +1,33 @@
 #include "luacpp/lua_object.h"
+#include <math.h>
 
 namespace luacpp {
 
+// converts `n` in the same way as `lua_tointeger()`
+static lua_Integer NumberToInteger(lua_Number n) {
+#if LUA_VERSION_NUM >= 503
+    // numbers with fractional parts cannot be converted
+    lua_Integer ret = 0;
+    if (floor(n) == n && lua_numbertointeger(n, &ret)) {
+        return ret;
+    }
+    return 0;
+#else
+    return (lua_Integer)n;
+#endif
+}
+
 bool LuaObject::ToBool() const {
-    PushSelf();
-    auto ret = lua_toboolean(m_l, -1);
-    lua_pop(m_l, 1);
-    return ret;
+    if (IsInline()) {
+        auto type = GetType();
+        if (type == LUA_TNIL) {
+            return false;
+        }
+        return (type == LUA_TBOOLEAN) ? m_value.b : true;
+    }
+
+    // collectable objects are always true
+    return true;
 }
 
 LuaStringRef LuaObject::ToStringRef() const {
@@ -28,6 +49,14 @@ const char* LuaObject::ToString() const {
 }
 
 lua_Integer LuaObject::ToInteger() const {
+    if (GetType() == LUA_TNUMBER) {
+        return m_is_integer ? m_value.i : NumberToInteger(m_value.n);
+    }
+    if (IsInline()) {
+        return 0;
+    }
+
+    // strings may be converted
     PushSelf();
     auto ret = lua_tointeger(m_l, -1);
     lua_pop(m_l, 1);
@@ -35,6 +64,14 @@ lua_Integer LuaObject::ToInteger() const {
 }
 
 lua_Number LuaObject::ToNumber() const {
+    if (GetType() == LUA_TNUMBER) {
+        return m_is_integer ? (lua_Number)m_value.i : m_value.n;
+    }
+    if (IsInline()) {
+        return 0;
+    }
+
+    // strings may be converted
     PushSelf();
     auto ret = lua_tonumber(m_l, -1);
     lua_pop(m_l, 1);
@@ -42,6 +79,10 @@ lua_Number LuaObject::ToNumber() const {
 }
 
 void* LuaObject::ToPointer() const {
+    if (IsInline()) {
+        return (GetType() == LUA_TLIGHTUSERDATA) ? m_value.p : nullptr;
+    }
+
     PushSelf();
     auto ret = lua_touserdata(m_l, -1);
     lua_pop(m_l, 1);
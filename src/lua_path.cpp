@@ -0,0 +1,142 @@
+#include "luacpp/lua_path.h"
+#include <ctype.h>
+#include <stdlib.h>
+using namespace std;
+
+namespace luacpp {
+
+void LuaPath::PushValue(lua_State* l, int idx) const {
+    idx = lua_absindex(l, idx);
+    const int base = lua_gettop(l) + 1;
+
+    // intermediate values are left on the stack and cleared at last
+    lua_pushvalue(l, idx);
+    for (auto& seg : m_segments) {
+        if (lua_type(l, -1) != LUA_TTABLE) {
+            lua_pushnil(l);
+            break;
+        }
+
+        if (seg.key_idx < 0) {
+            lua_rawgeti(l, -1, seg.index);
+        } else {
+            luacpp::PushValue(l, m_keys[seg.key_idx]);
+            lua_rawget(l, -2);
+        }
+    }
+
+    lua_replace(l, base);
+    lua_settop(l, base);
+}
+
+static bool IsNameStart(char c) {
+    return (isalpha((unsigned char)c) || c == '_');
+}
+
+static bool IsNameChar(char c) {
+    return (isalnum((unsigned char)c) || c == '_');
+}
+
+void LuaPath::AddKey(lua_State* l, const char* key, size_t len) {
+    lua_pushlstring(l, key, len);
+    m_keys.push_back(LuaKey(l, -1));
+    lua_pop(l, 1);
+    m_segments.push_back(Segment{0, (int)m_keys.size() - 1});
+}
+
+// parses a `[...]` segment starting at `*cursor`
+bool LuaPath::CompileBracket(lua_State* l, const char** cursor) {
+    const char* p = *cursor + 1;
+
+    if (*p == '\'' || *p == '"') {
+        const char quote = *p;
+        ++p;
+
+        string key;
+        while (*p && *p != quote) {
+            if (*p == '\\' && p[1]) {
+                ++p;
+            }
+            key.push_back(*p);
+            ++p;
+        }
+        if (*p != quote || p[1] != ']') {
+            *cursor = p;
+            return false;
+        }
+
+        AddKey(l, key.data(), key.size());
+        *cursor = p + 2;
+        return true;
+    }
+
+    char* end = nullptr;
+    auto index = strtoll(p, &end, 10);
+    if (end == p || *end != ']') {
+        *cursor = end;
+        return false;
+    }
+
+    m_segments.push_back(Segment{(lua_Integer)index, -1});
+    *cursor = end + 1;
+    return true;
+}
+
+// parses a name starting at `*cursor`
+bool LuaPath::CompileName(lua_State* l, const char** cursor) {
+    const char* p = *cursor;
+    if (!IsNameStart(*p)) {
+        return false;
+    }
+
+    do {
+        ++p;
+    } while (IsNameChar(*p));
+
+    AddKey(l, *cursor, p - *cursor);
+    *cursor = p;
+    return true;
+}
+
+/*
+  path := first ( '.' name | '[' integer ']' | '[' string ']' )*
+  first := name | '[' integer ']' | '[' string ']'
+
+  strings are quoted by `'` or `"`, in which `\` escapes the next character.
+*/
+bool LuaPath::Compile(lua_State* l, const char* path, string* errstr) {
+    m_segments.clear();
+    m_keys.clear();
+
+    const char* cursor = path;
+    bool ok = true;
+    while (ok && *cursor) {
+        if (*cursor == '[') {
+            ok = CompileBracket(l, &cursor);
+        } else if (m_segments.empty()) {
+            ok = CompileName(l, &cursor);
+        } else if (*cursor == '.') {
+            ++cursor;
+            ok = CompileName(l, &cursor);
+        } else {
+            ok = false;
+        }
+    }
+
+    if (ok && m_segments.empty()) {
+        ok = false;
+    }
+
+    if (!ok) {
+        if (errstr) {
+            *errstr = "invalid path `" + string(path) + "` at position " +
+                std::to_string(cursor - path) + ".";
+        }
+        m_segments.clear();
+        m_keys.clear();
+    }
+
+    return ok;
+}
+
+}
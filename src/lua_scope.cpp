@@ -0,0 +1,29 @@
+#include "luacpp/lua_scope.h"
+#include "luacpp/lua_state.h"
+
+namespace luacpp {
+
+// preallocated slots of the table
+static constexpr int SCOPE_TABLE_INIT_SIZE = 64;
+
+void LuaScope::Init(lua_State* l) {
+    m_l = l;
+    m_size = 0;
+
+    lua_createtable(l, SCOPE_TABLE_INIT_SIZE, 0);
+    m_table_ref = luaL_ref(l, LUA_REGISTRYINDEX);
+}
+
+LuaScope::LuaScope(lua_State* l) {
+    Init(l);
+}
+
+LuaScope::LuaScope(LuaState& l) {
+    Init(l.m_l);
+}
+
+LuaScope::~LuaScope() {
+    luaL_unref(m_l, LUA_REGISTRYINDEX, m_table_ref);
+}
+
+}
@@ -0,0 +1,259 @@
+#include "luacpp/lua_slab_allocator.h"
+#include <stdlib.h>
+#include <string.h>
+using namespace std;
+
+namespace luacpp {
+
+static constexpr uint32_t SMALL_CLASS_STEP = 16;
+static constexpr uint32_t SMALL_CLASS_MAX = 256;
+static constexpr uint32_t MEDIUM_CLASS_STEP = 32;
+static constexpr uint32_t MEDIUM_CLASS_MAX = 512;
+static constexpr uint32_t SMALL_CLASS_NUM = SMALL_CLASS_MAX / SMALL_CLASS_STEP;
+static constexpr uint32_t CLASS_NUM = SMALL_CLASS_NUM +
+    (MEDIUM_CLASS_MAX - SMALL_CLASS_MAX) / MEDIUM_CLASS_STEP;
+
+// every slab holds at least this number of blocks
+static constexpr uint32_t SLAB_MIN_BLOCK_NUM = 32;
+static constexpr uint32_t SLAB_MIN_SIZE = 4096;
+
+// keeps blocks after the header aligned as `malloc()` does
+static constexpr size_t SLAB_HEADER_SIZE = 16;
+
+/*
+  large blocks reserve a slab header in front of them, so that a large block
+  can be turned into a slab in place if shrinking it cannot allocate a block.
+*/
+static inline void* MallocLarge(size_t size) {
+    auto p = (char*)malloc(SLAB_HEADER_SIZE + size);
+    return p ? p + SLAB_HEADER_SIZE : nullptr;
+}
+
+static inline void* ReallocLarge(void* ptr, size_t size) {
+    auto p = (char*)realloc((char*)ptr - SLAB_HEADER_SIZE,
+                            SLAB_HEADER_SIZE + size);
+    return p ? p + SLAB_HEADER_SIZE : nullptr;
+}
+
+static inline void FreeLarge(void* ptr) {
+    free((char*)ptr - SLAB_HEADER_SIZE);
+}
+
+// returns `CLASS_NUM` for large blocks
+static inline uint32_t GetClassIndex(size_t size) {
+    if (size <= SMALL_CLASS_MAX) {
+        return (size + SMALL_CLASS_STEP - 1) / SMALL_CLASS_STEP - 1;
+    }
+    if (size <= MEDIUM_CLASS_MAX) {
+        return SMALL_CLASS_NUM +
+            (size - SMALL_CLASS_MAX + MEDIUM_CLASS_STEP - 1) /
+            MEDIUM_CLASS_STEP -
+            1;
+    }
+    return CLASS_NUM;
+}
+
+LuaSlabAllocator::LuaSlabAllocator()
+    : LuaAllocator(Alloc), m_slabs(nullptr), m_slab_bytes(0),
+      m_large_blocks(0), m_large_bytes(0) {
+    static_assert(sizeof(SlabHeader) <= SLAB_HEADER_SIZE,
+                  "slab header is too large");
+
+    m_classes.resize(CLASS_NUM);
+    for (uint32_t i = 0; i < CLASS_NUM; ++i) {
+        auto& cls = m_classes[i];
+        if (i < SMALL_CLASS_NUM) {
+            cls.block_size = (i + 1) * SMALL_CLASS_STEP;
+        } else {
+            cls.block_size =
+                SMALL_CLASS_MAX + (i - SMALL_CLASS_NUM + 1) * MEDIUM_CLASS_STEP;
+        }
+        cls.free_list = nullptr;
+        cls.used_blocks = 0;
+        cls.total_blocks = 0;
+        cls.requested_bytes = 0;
+    }
+}
+
+LuaSlabAllocator::~LuaSlabAllocator() {
+    while (m_slabs) {
+        auto next = m_slabs->next;
+        free(m_slabs);
+        m_slabs = next;
+    }
+}
+
+void* LuaSlabAllocator::AllocBlock(uint32_t class_idx) {
+    auto& cls = m_classes[class_idx];
+
+    if (!cls.free_list) {
+        uint32_t block_num = SLAB_MIN_SIZE / cls.block_size;
+        if (block_num < SLAB_MIN_BLOCK_NUM) {
+            block_num = SLAB_MIN_BLOCK_NUM;
+        }
+
+        // links slabs without containers, which may throw inside lua
+        const size_t slab_size =
+            SLAB_HEADER_SIZE + (size_t)block_num * cls.block_size;
+        auto header = (SlabHeader*)malloc(slab_size);
+        if (!header) {
+            return nullptr;
+        }
+        header->next = m_slabs;
+        m_slabs = header;
+        m_slab_bytes += slab_size;
+
+        auto slab = (char*)header + SLAB_HEADER_SIZE;
+        cls.total_blocks += block_num;
+
+        // links blocks in address order
+        for (uint32_t i = block_num; i > 0; --i) {
+            auto node = (FreeBlockNode*)(slab + (i - 1) * cls.block_size);
+            node->next = cls.free_list;
+            cls.free_list = node;
+        }
+    }
+
+    auto node = cls.free_list;
+    cls.free_list = node->next;
+    ++cls.used_blocks;
+    return node;
+}
+
+void LuaSlabAllocator::FreeBlock(uint32_t class_idx, void* ptr) {
+    auto& cls = m_classes[class_idx];
+    auto node = (FreeBlockNode*)ptr;
+    node->next = cls.free_list;
+    cls.free_list = node;
+    --cls.used_blocks;
+}
+
+void LuaSlabAllocator::Free(void* ptr, size_t osize) {
+    auto class_idx = GetClassIndex(osize);
+    if (class_idx < CLASS_NUM) {
+        m_classes[class_idx].requested_bytes -= osize;
+        FreeBlock(class_idx, ptr);
+    } else {
+        --m_large_blocks;
+        m_large_bytes -= osize;
+        FreeLarge(ptr);
+    }
+}
+
+/*
+  keeps `ptr` as a block of `new_idx` when shrinking it cannot allocate a new
+  block. a slab block is larger than blocks of `new_idx` and only changes its
+  class. a large block becomes a slab of one block using its reserved header.
+*/
+void* LuaSlabAllocator::KeepBlock(void* ptr, size_t osize, uint32_t old_idx,
+                                  uint32_t new_idx, size_t nsize) {
+    if (old_idx < CLASS_NUM) {
+        auto& old_cls = m_classes[old_idx];
+        old_cls.requested_bytes -= osize;
+        --old_cls.used_blocks;
+        --old_cls.total_blocks;
+    } else {
+        auto header = (SlabHeader*)((char*)ptr - SLAB_HEADER_SIZE);
+        header->next = m_slabs;
+        m_slabs = header;
+        m_slab_bytes += SLAB_HEADER_SIZE + osize;
+        --m_large_blocks;
+        m_large_bytes -= osize;
+    }
+
+    auto& cls = m_classes[new_idx];
+    cls.requested_bytes += nsize;
+    ++cls.used_blocks;
+    ++cls.total_blocks;
+    return ptr;
+}
+
+// `osize` is 0 if `ptr` is nullptr
+void* LuaSlabAllocator::Realloc(void* ptr, size_t osize, size_t nsize) {
+    auto old_idx = ptr ? GetClassIndex(osize) : CLASS_NUM + 1;
+    auto new_idx = GetClassIndex(nsize);
+
+    if (new_idx == old_idx) {
+        if (new_idx < CLASS_NUM) {
+            auto& cls = m_classes[new_idx];
+            cls.requested_bytes = cls.requested_bytes - osize + nsize;
+            return ptr;
+        }
+
+        auto ret = ReallocLarge(ptr, nsize);
+        if (ret) {
+            m_large_bytes = m_large_bytes - osize + nsize;
+        } else if (nsize <= osize) {
+            // lua 5.2 and 5.3 assume that shrinking never fails
+            m_large_bytes = m_large_bytes - osize + nsize;
+            ret = ptr;
+        }
+        return ret;
+    }
+
+    void* ret;
+    if (new_idx < CLASS_NUM) {
+        ret = AllocBlock(new_idx);
+        if (!ret) {
+            if (ptr && nsize <= osize) {
+                return KeepBlock(ptr, osize, old_idx, new_idx, nsize);
+            }
+            return nullptr;
+        }
+        m_classes[new_idx].requested_bytes += nsize;
+    } else {
+        ret = MallocLarge(nsize);
+        if (!ret) {
+            return nullptr;
+        }
+        ++m_large_blocks;
+        m_large_bytes += nsize;
+    }
+
+    if (ptr) {
+        memcpy(ret, ptr, (osize < nsize) ? osize : nsize);
+        Free(ptr, osize);
+    }
+
+    return ret;
+}
+
+void* LuaSlabAllocator::Alloc(void* ud, void* ptr, size_t osize,
+                              size_t nsize) {
+    auto allocator = (LuaSlabAllocator*)ud;
+
+    if (nsize == 0) {
+        if (ptr) {
+            allocator->Free(ptr, osize);
+        }
+        return nullptr;
+    }
+
+    // `osize` is the type of object being allocated if `ptr` is nullptr
+    return allocator->Realloc(ptr, ptr ? osize : 0, nsize);
+}
+
+void LuaSlabAllocator::GetStats(Stats* stats) const {
+    stats->size_classes.clear();
+    stats->size_classes.reserve(m_classes.size());
+
+    uint64_t requested_bytes = 0;
+    for (auto& cls : m_classes) {
+        SizeClassStats s;
+        s.block_size = cls.block_size;
+        s.used_blocks = cls.used_blocks;
+        s.total_blocks = cls.total_blocks;
+        s.requested_bytes = cls.requested_bytes;
+        stats->size_classes.push_back(s);
+        requested_bytes += cls.requested_bytes;
+    }
+
+    stats->large_blocks = m_large_blocks;
+    stats->large_bytes = m_large_bytes;
+    stats->slab_bytes = m_slab_bytes;
+    stats->fragmentation = (m_slab_bytes == 0)
+        ? 0
+        : (double)(m_slab_bytes - requested_bytes) / m_slab_bytes;
+}
+
+}
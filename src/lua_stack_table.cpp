@@ -0,0 +1,286 @@
+#include "luacpp/lua_stack_table.h"
+#include "luacpp/lua_table.h"
+#include "luacpp/lua_key.h"
+using namespace std;
+
+namespace luacpp {
+
+void LuaStackTable::PushRawField(const LuaKey& key) const {
+    PushValue(m_l, key);
+    lua_rawget(m_l, m_index);
+}
+
+// ----- getters ----- //
+
+LuaObject LuaStackTable::Get(int index) const {
+    lua_rawgeti(m_l, m_index, index);
+    LuaObject ret(m_l, -1);
+    lua_pop(m_l, 1);
+    return ret;
+}
+
+LuaObject LuaStackTable::Get(const char* name) const {
+    lua_getfield(m_l, m_index, name);
+    LuaObject ret(m_l, -1);
+    lua_pop(m_l, 1);
+    return ret;
+}
+
+LuaObject LuaStackTable::Get(const LuaKey& key) const {
+    PushRawField(key);
+    LuaObject ret(m_l, -1);
+    lua_pop(m_l, 1);
+    return ret;
+}
+
+LuaTable LuaStackTable::GetTable(int index) const {
+    lua_rawgeti(m_l, m_index, index);
+    LuaTable ret(m_l, -1);
+    lua_pop(m_l, 1);
+    return ret;
+}
+
+LuaTable LuaStackTable::GetTable(const char* name) const {
+    lua_getfield(m_l, m_index, name);
+    LuaTable ret(m_l, -1);
+    lua_pop(m_l, 1);
+    return ret;
+}
+
+LuaTable LuaStackTable::GetTable(const LuaKey& key) const {
+    PushRawField(key);
+    LuaTable ret(m_l, -1);
+    lua_pop(m_l, 1);
+    return ret;
+}
+
+LuaFunction LuaStackTable::GetFunction(int index) const {
+    lua_rawgeti(m_l, m_index, index);
+    LuaFunction ret(m_l, -1);
+    lua_pop(m_l, 1);
+    return ret;
+}
+
+LuaFunction LuaStackTable::GetFunction(const char* name) const {
+    lua_getfield(m_l, m_index, name);
+    LuaFunction ret(m_l, -1);
+    lua_pop(m_l, 1);
+    return ret;
+}
+
+LuaFunction LuaStackTable::GetFunction(const LuaKey& key) const {
+    PushRawField(key);
+    LuaFunction ret(m_l, -1);
+    lua_pop(m_l, 1);
+    return ret;
+}
+
+LuaStringRef LuaStackTable::GetStringRef(int index) const {
+    lua_rawgeti(m_l, m_index, index);
+    size_t len = 0;
+    const char* str = lua_tolstring(m_l, -1, &len);
+    lua_pop(m_l, 1);
+    return LuaStringRef(str, len);
+}
+
+LuaStringRef LuaStackTable::GetStringRef(const char* name) const {
+    lua_getfield(m_l, m_index, name);
+    size_t len = 0;
+    const char* str = lua_tolstring(m_l, -1, &len);
+    lua_pop(m_l, 1);
+    return LuaStringRef(str, len);
+}
+
+LuaStringRef LuaStackTable::GetStringRef(const LuaKey& key) const {
+    PushRawField(key);
+    size_t len = 0;
+    const char* str = lua_tolstring(m_l, -1, &len);
+    lua_pop(m_l, 1);
+    return LuaStringRef(str, len);
+}
+
+const char* LuaStackTable::GetString(int index) const {
+    lua_rawgeti(m_l, m_index, index);
+    const char* str = lua_tostring(m_l, -1);
+    lua_pop(m_l, 1);
+    return str;
+}
+
+const char* LuaStackTable::GetString(const char* name) const {
+    lua_getfield(m_l, m_index, name);
+    const char* str = lua_tostring(m_l, -1);
+    lua_pop(m_l, 1);
+    return str;
+}
+
+const char* LuaStackTable::GetString(const LuaKey& key) const {
+    PushRawField(key);
+    const char* str = lua_tostring(m_l, -1);
+    lua_pop(m_l, 1);
+    return str;
+}
+
+lua_Number LuaStackTable::GetNumber(int index) const {
+    lua_rawgeti(m_l, m_index, index);
+    lua_Number n = lua_tonumber(m_l, -1);
+    lua_pop(m_l, 1);
+    return n;
+}
+
+lua_Number LuaStackTable::GetNumber(const char* name) const {
+    lua_getfield(m_l, m_index, name);
+    lua_Number n = lua_tonumber(m_l, -1);
+    lua_pop(m_l, 1);
+    return n;
+}
+
+lua_Number LuaStackTable::GetNumber(const LuaKey& key) const {
+    PushRawField(key);
+    lua_Number n = lua_tonumber(m_l, -1);
+    lua_pop(m_l, 1);
+    return n;
+}
+
+lua_Integer LuaStackTable::GetInteger(int index) const {
+    lua_rawgeti(m_l, m_index, index);
+    lua_Integer n = lua_tointeger(m_l, -1);
+    lua_pop(m_l, 1);
+    return n;
+}
+
+lua_Integer LuaStackTable::GetInteger(const char* name) const {
+    lua_getfield(m_l, m_index, name);
+    lua_Integer n = lua_tointeger(m_l, -1);
+    lua_pop(m_l, 1);
+    return n;
+}
+
+lua_Integer LuaStackTable::GetInteger(const LuaKey& key) const {
+    PushRawField(key);
+    lua_Integer n = lua_tointeger(m_l, -1);
+    lua_pop(m_l, 1);
+    return n;
+}
+
+void* LuaStackTable::GetPointer(int index) const {
+    lua_rawgeti(m_l, m_index, index);
+    void* ptr = lua_touserdata(m_l, -1);
+    lua_pop(m_l, 1);
+    return ptr;
+}
+
+void* LuaStackTable::GetPointer(const char* name) const {
+    lua_getfield(m_l, m_index, name);
+    void* ptr = lua_touserdata(m_l, -1);
+    lua_pop(m_l, 1);
+    return ptr;
+}
+
+void* LuaStackTable::GetPointer(const LuaKey& key) const {
+    PushRawField(key);
+    void* ptr = lua_touserdata(m_l, -1);
+    lua_pop(m_l, 1);
+    return ptr;
+}
+
+// ----- setters ----- //
+
+void LuaStackTable::Set(int index, const LuaRefObject& lobj) {
+    PushValue(m_l, lobj);
+    lua_rawseti(m_l, m_index, index);
+}
+
+void LuaStackTable::Set(const char* name, const LuaRefObject& lobj) {
+    PushValue(m_l, lobj);
+    lua_setfield(m_l, m_index, name);
+}
+
+void LuaStackTable::Set(const LuaKey& key, const LuaRefObject& lobj) {
+    PushValue(m_l, key);
+    PushValue(m_l, lobj);
+    lua_rawset(m_l, m_index);
+}
+
+void LuaStackTable::SetString(int index, const char* str) {
+    lua_pushstring(m_l, str);
+    lua_rawseti(m_l, m_index, index);
+}
+
+void LuaStackTable::SetString(int index, const char* str, uint64_t len) {
+    lua_pushlstring(m_l, str, len);
+    lua_rawseti(m_l, m_index, index);
+}
+
+void LuaStackTable::SetString(const char* name, const char* str) {
+    lua_pushstring(m_l, str);
+    lua_setfield(m_l, m_index, name);
+}
+
+void LuaStackTable::SetString(const char* name, const char* str,
+                              uint64_t len) {
+    lua_pushlstring(m_l, str, len);
+    lua_setfield(m_l, m_index, name);
+}
+
+void LuaStackTable::SetString(const LuaKey& key, const char* str) {
+    PushValue(m_l, key);
+    lua_pushstring(m_l, str);
+    lua_rawset(m_l, m_index);
+}
+
+void LuaStackTable::SetString(const LuaKey& key, const char* str,
+                              uint64_t len) {
+    PushValue(m_l, key);
+    lua_pushlstring(m_l, str, len);
+    lua_rawset(m_l, m_index);
+}
+
+void LuaStackTable::SetNumber(int index, lua_Number value) {
+    lua_pushnumber(m_l, value);
+    lua_rawseti(m_l, m_index, index);
+}
+
+void LuaStackTable::SetNumber(const char* name, lua_Number value) {
+    lua_pushnumber(m_l, value);
+    lua_setfield(m_l, m_index, name);
+}
+
+void LuaStackTable::SetNumber(const LuaKey& key, lua_Number value) {
+    PushValue(m_l, key);
+    lua_pushnumber(m_l, value);
+    lua_rawset(m_l, m_index);
+}
+
+void LuaStackTable::SetInteger(int index, lua_Integer value) {
+    lua_pushinteger(m_l, value);
+    lua_rawseti(m_l, m_index, index);
+}
+
+void LuaStackTable::SetInteger(const char* name, lua_Integer value) {
+    lua_pushinteger(m_l, value);
+    lua_setfield(m_l, m_index, name);
+}
+
+void LuaStackTable::SetInteger(const LuaKey& key, lua_Integer value) {
+    PushValue(m_l, key);
+    lua_pushinteger(m_l, value);
+    lua_rawset(m_l, m_index);
+}
+
+void LuaStackTable::SetPointer(int index, void* ptr) {
+    lua_pushlightuserdata(m_l, ptr);
+    lua_rawseti(m_l, m_index, index);
+}
+
+void LuaStackTable::SetPointer(const char* name, void* ptr) {
+    lua_pushlightuserdata(m_l, ptr);
+    lua_setfield(m_l, m_index, name);
+}
+
+void LuaStackTable::SetPointer(const LuaKey& key, void* ptr) {
+    PushValue(m_l, key);
+    lua_pushlightuserdata(m_l, ptr);
+    lua_rawset(m_l, m_index);
+}
+
+}
@@ -1,8 +1,23 @@
 #include "luacpp/lua_state.h"
 #include "luacpp/lua_table.h"
 #include "luacpp/lua_function.h"
+#include "luacpp/lua_slab_allocator.h"
+#include "luacpp/lua_memory_limit_allocator.h"
+#include "luacpp/lua_arena_allocator.h"
+#include "luacpp/lua_bytecode_cache.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <istream>
 using namespace std;
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 namespace luacpp {
 
 static inline void DummyDeleter(lua_State*) {}
@@ -10,11 +25,17 @@ static inline void DummyDeleter(lua_State*) {}
 LuaState::LuaState(LuaState&& rhs) {
     m_l = rhs.m_l;
     m_deleter = rhs.m_deleter;
+    m_allocator = rhs.m_allocator;
     m_gc_table_ref = rhs.m_gc_table_ref;
+    m_property_metatable_ref = rhs.m_property_metatable_ref;
+    m_bytecode_cache_dir = std::move(rhs.m_bytecode_cache_dir);
+    m_chunk_cache = std::move(rhs.m_chunk_cache);
 
     rhs.m_l = nullptr;
     rhs.m_deleter = DummyDeleter;
+    rhs.m_allocator = nullptr;
     rhs.m_gc_table_ref = LUA_REFNIL;
+    rhs.m_property_metatable_ref = LUA_REFNIL;
 }
 
 LuaState& LuaState::operator=(LuaState&& rhs) {
@@ -23,16 +44,26 @@ LuaState& LuaState::operator=(LuaState&& rhs) {
     }
 
     if (m_l) {
+        m_chunk_cache.Clear(m_l);
+        luaL_unref(m_l, LUA_REGISTRYINDEX, m_gc_table_ref);
+        luaL_unref(m_l, LUA_REGISTRYINDEX, m_property_metatable_ref);
         m_deleter(m_l);
     }
+    delete m_allocator;
 
     m_l = rhs.m_l;
     m_deleter = rhs.m_deleter;
+    m_allocator = rhs.m_allocator;
     m_gc_table_ref = rhs.m_gc_table_ref;
+    m_property_metatable_ref = rhs.m_property_metatable_ref;
+    m_bytecode_cache_dir = std::move(rhs.m_bytecode_cache_dir);
+    m_chunk_cache = std::move(rhs.m_chunk_cache);
 
     rhs.m_l = nullptr;
     rhs.m_deleter = DummyDeleter;
+    rhs.m_allocator = nullptr;
     rhs.m_gc_table_ref = LUA_REFNIL;
+    rhs.m_property_metatable_ref = LUA_REFNIL;
 
     return *this;
 }
@@ -44,6 +75,22 @@ static inline int CreateGcTable(lua_State* l) {
     return luaL_ref(l, LUA_REGISTRYINDEX);
 }
 
+/*
+  returns the property at `idx`, or nullptr if it is not a property. metatables
+  of classes can be modified by scripts, so only userdata whose metatable is
+  the property metatable, which is upvalue 1 of metamethods of classes and
+  instances, are properties.
+*/
+static PropertyWrapperBase* ToProperty(lua_State* l, int idx) {
+    if (lua_type(l, idx) != LUA_TUSERDATA || !lua_getmetatable(l, idx)) {
+        return nullptr;
+    }
+    bool is_property = lua_rawequal(l, -1, lua_upvalueindex(1));
+    lua_pop(l, 1);
+    return is_property ? (PropertyWrapperBase*)lua_touserdata(l, idx)
+                       : nullptr;
+}
+
 int LuaState::luacpp_index_for_class(lua_State* l) {
     auto key = lua_tostring(l, 2);
 
@@ -62,17 +109,12 @@ int LuaState::luacpp_index_for_class(lua_State* l) {
 
     /* case 2: is a property */
 
-    if (lua_istable(l, -1)) {
-        lua_rawgeti(l, -1, MEMBER_GETTER_IDX);
-        if (lua_isnil(l, -1)) {
-            luaL_error(l, "cannot read `%s`.", key);
-            return 1;
+    auto prop = ToProperty(l, -1);
+    if (prop) {
+        if (!prop->get) {
+            return luaL_error(l, "cannot read `%s`.", key);
         }
-
-        lua_pushvalue(l, 1); // userdata
-        lua_pushvalue(l, 2); // the key
-        lua_pcall(l, 2, 1, 0);
-
+        prop->get(l, prop, 1);
         return 1;
     }
 
@@ -161,19 +203,12 @@ int LuaState::luacpp_newindex_for_class(lua_State* l) {
 
     /* case 1: is a property */
 
-    if (lua_istable(l, -1)) {
-        lua_rawgeti(l, -1, MEMBER_SETTER_IDX);
-        if (lua_isnil(l, -1)) {
-            luaL_error(l, "cannot write `%s`.", key);
-            return 0;
+    auto prop = ToProperty(l, -1);
+    if (prop) {
+        if (!prop->set) {
+            return luaL_error(l, "cannot write `%s`.", key);
         }
-        if (!lua_isfunction(l, -1)) {
-            luaL_error(l, "`setter` is not a function.");
-            return 0;
-        }
-        lua_pushvalue(l, 1); // classdata
-        lua_pushvalue(l, 3); // new value
-        lua_pcall(l, 2, 0, 0);
+        prop->set(l, prop, 1, 3);
         return 0;
     }
 
@@ -222,8 +257,6 @@ int LuaState::luacpp_newindex_for_class(lua_State* l) {
 /*
   parameters:
 
-  +---------------+
-  | current class | <- (optional) pushed by derived instance
   +---------------+
   |      key      |
   +---------------+
@@ -231,193 +264,43 @@ int LuaState::luacpp_newindex_for_class(lua_State* l) {
   +---------------+
 */
 int LuaState::luacpp_index_for_class_instance(lua_State* l) {
-    auto key = lua_tostring(l, 2);
-
-    // cannot use `lua_getiuservalue` because this userdata may be used as a
-    // parent class instance
-    if (lua_gettop(l) == 2) { // called by lua from `__index`
-        lua_getiuservalue(l, 1, 1); // the class
-    }
-    lua_getiuservalue(l, -1, CLASS_INSTANCE_METATABLE_IDX);
+    lua_getiuservalue(l, 1, 1); // the class
+    PushClassLookupTable(l, -1);
 
     /*
-      +--------------------------+
-      | class instance metatable |
-      +--------------------------+
-      |      current class       |
-      +--------------------------+
-      |           key            |
-      +--------------------------+
-      |        userdata          |
-      +--------------------------+
+      +--------------+
+      | lookup table |
+      +--------------+
+      |    class     |
+      +--------------+
+      |     key      |
+      +--------------+
+      |   userdata   |
+      +--------------+
     */
 
-    if (lua_isnil(l, -1)) {
-        return 1;
-    }
+    lua_pushvalue(l, 2);
+    lua_rawget(l, -2);
 
-    lua_getfield(l, -1, key);
-
-    /* case 1: is a member function */
+    /* case 1: is a member function or static member function */
 
     if (lua_isfunction(l, -1)) {
         return 1;
     }
 
-    /* case 2: is a property */
+    /* case 2: is a property or static property */
 
-    if (lua_istable(l, -1)) {
-        lua_rawgeti(l, -1, MEMBER_GETTER_IDX);
-        if (lua_isnil(l, -1)) {
-            luaL_error(l, "cannot read `%s`.", key);
-            return 1;
+    auto prop = ToProperty(l, -1);
+    if (prop) {
+        if (!prop->get) {
+            return luaL_error(l, "cannot read `%s`.", lua_tostring(l, 2));
         }
-
-        lua_pushvalue(l, 1); // userdata
-        lua_pushvalue(l, 2); // the key
-        lua_pcall(l, 2, 1, 0);
-        return 1;
-    }
-
-    /* case 3: is not a field exported by c++ */
-
-    if (!lua_isnil(l, -1)) {
-        lua_pushnil(l);
-        return 1;
-    }
-
-    /* case 4: not found in current instance */
-
-    lua_pop(l, 2);
-
-    /*
-      +-------+
-      | class |
-      +-------+
-      |  ...  |
-      +-------+
-    */
-
-    /* case 4.1: find from the class because this key may be a static member */
-
-    lua_getmetatable(l, -1);
-
-    /*
-      +-----------+
-      | metatable |
-      +-----------+
-      |   class   |
-      +-----------+
-      |    ...    |
-      +-----------+
-    */
-
-    lua_getfield(l, -1, key);
-    if (!lua_isnil(l, -1)) {
+        prop->get(l, prop, 1);
         return 1;
     }
 
-    /* case 4.2: find from parents */
-
-    lua_pop(l, 2);
-
-    // get parent table
-    lua_getiuservalue(l, -1, CLASS_PARENT_TABLE_IDX);
-
-    /*
-      +--------------+
-      | parent table |
-      +--------------+
-      |      ...     |
-      +--------------+
-    */
+    /* case 3: not found or is not a field exported by c++ */
 
-    // iterate all parent classes until the key is found
-    lua_pushnil(l);
-    while (lua_next(l, -2) != 0) {
-        /*
-          +--------------+
-          |    parent    |
-          +--------------+
-          |  key(unused) |
-          +--------------+
-          | parent table |
-          +--------------+
-          |      ...     |
-          +--------------+
-        */
-
-        // get instance's metatable
-        lua_getiuservalue(l, -1, CLASS_INSTANCE_METATABLE_IDX);
-
-        /*
-          +--------------+
-          |  metatable   |
-          +--------------+
-          |    parent    |
-          +--------------+
-          |  key(unused) |
-          +--------------+
-          | parent table |
-          +--------------+
-          |      ...     |
-          +--------------+
-        */
-
-        // get __index value from parent's instance metatable
-        lua_getfield(l, -1, "__index");
-
-        /*
-          +--------------+
-          |   __index    |
-          +--------------+
-          |  metatable   |
-          +--------------+
-          |    parent    |
-          +--------------+
-          |  key(unused) |
-          +--------------+
-          | parent table |
-          +--------------+
-          |      ...     |
-          +--------------+
-        */
-
-        if (lua_isfunction(l, -1)) {
-            lua_pushvalue(l, 1); // userdata
-            lua_pushvalue(l, 2); // the key
-            lua_pushvalue(l, -5); // parent class
-            lua_pcall(l, 3, 1, 0);
-            if (!lua_isnil(l, -1)) {
-                return 1;
-            }
-        } else {
-            lua_getfield(l, -1, key);
-            if (!lua_isnil(l, -1)) {
-                return 1;
-            }
-        }
-
-        /*
-          +--------------+
-          |     res      |
-          +--------------+
-          |  metatable   |
-          +--------------+
-          |    parent    |
-          +--------------+
-          |  key(unused) |
-          +--------------+
-          | parent table |
-          +--------------+
-          |      ...     |
-          +--------------+
-        */
-
-        lua_pop(l, 3);
-    }
-
-    // not found
     lua_pushnil(l);
     return 1;
 }
@@ -425,8 +308,6 @@ int LuaState::luacpp_index_for_class_instance(lua_State* l) {
 /*
   parameters:
 
-  +---------------+
-  | current class | <- (optional) pushed by derived instance
   +---------------+
   |   new value   |
   +---------------+
@@ -436,198 +317,45 @@ int LuaState::luacpp_index_for_class_instance(lua_State* l) {
   +---------------+
 */
 int LuaState::luacpp_newindex_for_class_instance(lua_State* l) {
-    auto key = lua_tostring(l, 2);
-
-    // cannot use `lua_getiuservalue` because this userdata may be used as a
-    // parent class instance
-    if (lua_gettop(l) == 3) {
-        lua_getiuservalue(l, 1, 1);
-    }
-
-    lua_getiuservalue(l, -1, CLASS_INSTANCE_METATABLE_IDX);
+    lua_getiuservalue(l, 1, 1); // the class
+    PushClassLookupTable(l, -1);
 
     /*
-      +--------------------------+
-      | class instance metatable |
-      +--------------------------+
-      |      current class       |
-      +--------------------------+
-      |        new value         |
-      +--------------------------+
-      |           key            |
-      +--------------------------+
-      |        userdata          |
-      +--------------------------+
-    */
-
-    if (lua_isnil(l, -1)) {
-        luaL_error(l, "cannot find metatable of class instances.");
-        return 0;
-    }
-
-    lua_getfield(l, -1, key);
-
-    /*
-      +--------------------------+
-      |       value of key       |
-      +--------------------------+
-      | class instance metatable |
-      +--------------------------+
-      |      current class       |
-      +--------------------------+
-      |        new value         |
-      +--------------------------+
-      |           key            |
-      +--------------------------+
-      |        userdata          |
-      +--------------------------+
-    */
-
-    /* case 1: is a property */
-
-    if (lua_istable(l, -1)) {
-        lua_rawgeti(l, -1, MEMBER_SETTER_IDX);
-        if (lua_isnil(l, -1)) {
-            luaL_error(l, "cannot write `%s`.", key);
-            return 0;
-        }
-        if (!lua_isfunction(l, -1)) {
-            luaL_error(l, "`setter` is not a function.");
-            return 0;
-        }
-        lua_pushvalue(l, 1); // userdata
-        lua_pushvalue(l, 3); // new value
-        lua_pcall(l, 2, 0, 0);
-        return 0;
-    }
-
-    // is not a writable field exported by c++
-    if (!lua_isnil(l, -1)) {
-        luaL_error(l, "`%s` is not a writable field exported by c++.", key);
-        return 0;
-    }
-
-    /* case 2: is a static member */
-
-    lua_pop(l, 2);
-
-    /*
-      +-------+
-      | class |
-      +-------+
-      |  ...  |
-      +-------+
+      +--------------+
+      | lookup table |
+      +--------------+
+      |    class     |
+      +--------------+
+      |  new value   |
+      +--------------+
+      |     key      |
+      +--------------+
+      |   userdata   |
+      +--------------+
     */
 
-    lua_getmetatable(l, -1);
+    lua_pushvalue(l, 2);
+    lua_rawget(l, -2);
 
-    /*
-      +-----------+
-      | metatable |
-      +-----------+
-      |   class   |
-      +-----------+
-      |    ...    |
-      +-----------+
-    */
+    /* case 1: is a property or static property */
 
-    lua_getfield(l, -1, key);
-    if (lua_istable(l, -1)) {
-        lua_rawgeti(l, -1, MEMBER_SETTER_IDX);
-        if (lua_isnil(l, -1)) {
-            luaL_error(l, "cannot write `%s`.", key);
-            return 0;
+    auto prop = ToProperty(l, -1);
+    if (prop) {
+        if (!prop->set) {
+            return luaL_error(l, "cannot write `%s`.", lua_tostring(l, 2));
         }
-        if (!lua_isfunction(l, -1)) {
-            luaL_error(l, "`setter` is not a function.");
-            return 0;
-        }
-        lua_pushvalue(l, 1); // userdata
-        lua_pushvalue(l, 3); // new value
-        lua_pcall(l, 2, 0, 0);
+        prop->set(l, prop, 1, 3);
         return 0;
     }
 
     // is not a writable field exported by c++
     if (!lua_isnil(l, -1)) {
-        luaL_error(l, "`%s` is not a writable field exported by c++.", key);
+        luaL_error(l, "`%s` is not a writable field exported by c++.",
+                   lua_tostring(l, 2));
         return 0;
     }
 
-    lua_pop(l, 2);
-
-    /* case 3: not found in current class */
-
-    // get parent table
-    lua_getiuservalue(l, -1, CLASS_PARENT_TABLE_IDX);
-
-    /*
-      +--------------+
-      | parent table |
-      +--------------+
-      |      ...     |
-      +--------------+
-    */
-
-    // iterate all parent classes until the key is found
-    lua_pushnil(l);
-    while (lua_next(l, -2) != 0) {
-        /*
-          +--------------+
-          |    parent    |
-          +--------------+
-          |  key(unused) |
-          +--------------+
-          | parent table |
-          +--------------+
-          |      ...     |
-          +--------------+
-        */
-
-        lua_getiuservalue(l, -1, CLASS_INSTANCE_METATABLE_IDX);
-
-        /*
-          +--------------------+
-          | instance metatable |
-          +--------------------+
-          |       parent       |
-          +--------------------+
-          |     key(unused)    |
-          +--------------------+
-          |    parent table    |
-          +--------------------+
-          |         ...        |
-          +--------------------+
-        */
-
-        // get __newindex value from parent's instance metatable
-        lua_getfield(l, -1, "__newindex");
-
-        /*
-          +--------------------+
-          |     __newindex     |
-          +--------------------+
-          | instance metatable |
-          +--------------------+
-          |       parent       |
-          +--------------------+
-          |     key(unused)    |
-          +--------------------+
-          |    parent table    |
-          +--------------------+
-          |         ...        |
-          +--------------------+
-        */
-
-        if (lua_isfunction(l, -1)) {
-            lua_pushvalue(l, 1); // userdata
-            lua_pushvalue(l, 2); // the key
-            lua_pushvalue(l, 3); // new value
-            lua_pushvalue(l, -6); // parent class
-            lua_pcall(l, 4, 0, 0);
-            return 0;
-        }
-    }
+    /* case 2: not found */
 
     return 0;
 }
@@ -636,10 +364,13 @@ void LuaState::CreateClassMetatable(lua_State* l) {
     // sets a metatable so that it becomes callable via __call
     lua_createtable(l, 0, 2);
 
-    lua_pushcfunction(l, luacpp_newindex_for_class);
+    // upvalue 1 of metamethods is the property metatable
+    lua_rawgeti(l, LUA_REGISTRYINDEX, m_property_metatable_ref);
+    lua_pushcclosure(l, luacpp_newindex_for_class, 1);
     lua_setfield(l, -2, "__newindex");
 
-    lua_pushcfunction(l, luacpp_index_for_class);
+    lua_rawgeti(l, LUA_REGISTRYINDEX, m_property_metatable_ref);
+    lua_pushcclosure(l, luacpp_index_for_class, 1);
     lua_setfield(l, -2, "__index");
 }
 
@@ -649,12 +380,14 @@ void LuaState::CreateClassInstanceMetatable(lua_State* l,
     lua_createtable(l, 0, 3);
 
     // sets the __newindex field so that userdata can modify members
-    lua_pushcfunction(l, luacpp_newindex_for_class_instance);
+    lua_rawgeti(l, LUA_REGISTRYINDEX, m_property_metatable_ref);
+    lua_pushcclosure(l, luacpp_newindex_for_class_instance, 1);
     lua_setfield(l, -2, "__newindex");
 
     // sets the __index field to be itself so that userdata can find member
     // functions
-    lua_pushcfunction(l, luacpp_index_for_class_instance);
+    lua_rawgeti(l, LUA_REGISTRYINDEX, m_property_metatable_ref);
+    lua_pushcclosure(l, luacpp_index_for_class_instance, 1);
     lua_setfield(l, -2, "__index");
 
     // destructor for class instances
@@ -664,6 +397,7 @@ void LuaState::CreateClassInstanceMetatable(lua_State* l,
 
 LuaState::LuaState(lua_State* l, bool is_owner) {
     m_l = l;
+    m_allocator = nullptr;
     if (is_owner) {
         luaL_openlibs(l);
         m_deleter = lua_close;
@@ -672,13 +406,110 @@ LuaState::LuaState(lua_State* l, bool is_owner) {
     }
 
     m_gc_table_ref = CreateGcTable(l);
+
+    // a separate table so that properties can be told from other userdata
+    m_property_metatable_ref = CreateGcTable(l);
+}
+
+// same as the panic function of `luaL_newstate()`
+static int PanicHandler(lua_State* l) {
+    const char* msg = (lua_type(l, -1) == LUA_TSTRING)
+        ? lua_tostring(l, -1) : "error object is not a string";
+    fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", msg);
+    fflush(stderr);
+    return 0;
+}
+
+#if LUA_VERSION_NUM >= 504
+/*
+  same as warning functions of `luaL_newstate()`: warnings are off by default
+  and can be turned on or off by control messages "@on" and "@off".
+*/
+static void WarnOff(void* ud, const char* msg, int tocont);
+static void WarnOn(void* ud, const char* msg, int tocont);
+static void WarnCont(void* ud, const char* msg, int tocont);
+
+static bool CheckWarnControl(lua_State* l, const char* msg, int tocont) {
+    if (tocont || *(msg++) != '@') {
+        return false;
+    }
+
+    if (strcmp(msg, "off") == 0) {
+        lua_setwarnf(l, WarnOff, l);
+    } else if (strcmp(msg, "on") == 0) {
+        lua_setwarnf(l, WarnOn, l);
+    }
+    return true;
+}
+
+static void WarnOff(void* ud, const char* msg, int tocont) {
+    CheckWarnControl((lua_State*)ud, msg, tocont);
+}
+
+static void WarnCont(void* ud, const char* msg, int tocont) {
+    auto l = (lua_State*)ud;
+    fprintf(stderr, "%s", msg);
+    if (tocont) {
+        lua_setwarnf(l, WarnCont, l);
+    } else {
+        fprintf(stderr, "\n");
+        fflush(stderr);
+        lua_setwarnf(l, WarnOn, l);
+    }
+}
+
+static void WarnOn(void* ud, const char* msg, int tocont) {
+    if (CheckWarnControl((lua_State*)ud, msg, tocont)) {
+        return;
+    }
+    fprintf(stderr, "Lua warning: ");
+    WarnCont(ud, msg, tocont);
+}
+#endif
+
+unique_ptr<LuaState> LuaState::NewWithAllocator(LuaAllocator* allocator) {
+    auto l = lua_newstate(allocator->GetAllocFunc(), allocator);
+    if (!l) {
+        delete allocator;
+        return unique_ptr<LuaState>();
+    }
+
+    lua_atpanic(l, PanicHandler);
+#if LUA_VERSION_NUM >= 504
+    lua_setwarnf(l, WarnOff, l);
+#endif
+
+    unique_ptr<LuaState> ret(new LuaState(l, true));
+    ret->m_allocator = allocator;
+    return ret;
 }
 
 LuaState::~LuaState() {
     if (m_l) { // not moved
+        m_chunk_cache.Clear(m_l);
         luaL_unref(m_l, LUA_REGISTRYINDEX, m_gc_table_ref);
+        luaL_unref(m_l, LUA_REGISTRYINDEX, m_property_metatable_ref);
         m_deleter(m_l);
     }
+    delete m_allocator;
+}
+
+unique_ptr<LuaState> LuaState::NewWithSlabAllocator() {
+    return NewWithAllocator(new LuaSlabAllocator());
+}
+
+unique_ptr<LuaState> LuaState::NewWithMemoryLimit(uint64_t soft_limit,
+                                                  uint64_t hard_limit) {
+    auto allocator = new LuaMemoryLimitAllocator();
+    auto l = NewWithAllocator(allocator);
+    if (l) {
+        allocator->SetLimits(soft_limit, hard_limit);
+    }
+    return l;
+}
+
+unique_ptr<LuaState> LuaState::NewDisposable(size_t chunk_size) {
+    return NewWithAllocator(new LuaArenaAllocator(chunk_size));
 }
 
 void LuaState::Set(const char* name, const LuaRefObject& lobj) {
@@ -722,6 +553,86 @@ void* LuaState::GetPointer(const char* name) const {
     return ptr;
 }
 
+void LuaState::Set(const LuaKey& key, const LuaRefObject& lobj) {
+    lua_rawgeti(m_l, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+    PushValue(m_l, key);
+    PushValue(m_l, lobj);
+    lua_rawset(m_l, -3);
+    lua_pop(m_l, 1);
+}
+
+const char* LuaState::GetString(const LuaKey& key) const {
+    PushRawGlobal(key);
+    const char* str = lua_tostring(m_l, -1);
+    lua_pop(m_l, 2);
+    return str;
+}
+
+const char* LuaState::GetString(const LuaPath& path) const {
+    PushPathValue(path);
+    const char* str = lua_tostring(m_l, -1);
+    lua_pop(m_l, 2);
+    return str;
+}
+
+LuaStringRef LuaState::GetStringRef(const LuaKey& key) const {
+    PushRawGlobal(key);
+    size_t len = 0;
+    const char* str = lua_tolstring(m_l, -1, &len);
+    lua_pop(m_l, 2);
+    return LuaStringRef(str, len);
+}
+
+LuaStringRef LuaState::GetStringRef(const LuaPath& path) const {
+    PushPathValue(path);
+    size_t len = 0;
+    const char* str = lua_tolstring(m_l, -1, &len);
+    lua_pop(m_l, 2);
+    return LuaStringRef(str, len);
+}
+
+lua_Number LuaState::GetNumber(const LuaKey& key) const {
+    PushRawGlobal(key);
+    auto value = lua_tonumber(m_l, -1);
+    lua_pop(m_l, 2);
+    return value;
+}
+
+lua_Number LuaState::GetNumber(const LuaPath& path) const {
+    PushPathValue(path);
+    auto value = lua_tonumber(m_l, -1);
+    lua_pop(m_l, 2);
+    return value;
+}
+
+lua_Integer LuaState::GetInteger(const LuaKey& key) const {
+    PushRawGlobal(key);
+    auto value = lua_tointeger(m_l, -1);
+    lua_pop(m_l, 2);
+    return value;
+}
+
+lua_Integer LuaState::GetInteger(const LuaPath& path) const {
+    PushPathValue(path);
+    auto value = lua_tointeger(m_l, -1);
+    lua_pop(m_l, 2);
+    return value;
+}
+
+void* LuaState::GetPointer(const LuaKey& key) const {
+    PushRawGlobal(key);
+    auto ptr = lua_touserdata(m_l, -1);
+    lua_pop(m_l, 2);
+    return ptr;
+}
+
+void* LuaState::GetPointer(const LuaPath& path) const {
+    PushPathValue(path);
+    auto ptr = lua_touserdata(m_l, -1);
+    lua_pop(m_l, 2);
+    return ptr;
+}
+
 LuaObject LuaState::CreateString(const char* str, const char* name) {
     lua_pushstring(m_l, str);
     LuaObject ret(m_l, -1);
@@ -791,40 +702,318 @@ LuaTable LuaState::CreateTable(const char* name) {
     return ret;
 }
 
-bool LuaState::DoString(
-    const char* chunk, string* errstr,
+LuaKey LuaState::CreateKey(const char* str) {
+    lua_pushstring(m_l, str);
+    LuaKey ret(m_l, -1);
+    lua_pop(m_l, 1);
+    return ret;
+}
+
+LuaKey LuaState::CreateKey(const char* str, uint64_t len) {
+    lua_pushlstring(m_l, str, len);
+    LuaKey ret(m_l, -1);
+    lua_pop(m_l, 1);
+    return ret;
+}
+
+bool LuaState::CreatePath(const char* path, LuaPath* res, string* errstr) {
+    return res->Compile(m_l, path, errstr);
+}
+
+bool LuaState::GcStepFor(chrono::microseconds budget) {
+    auto deadline = chrono::steady_clock::now() + budget;
+    do {
+        if (lua_gc(m_l, LUA_GCSTEP, 0)) {
+            return true;
+        }
+    } while (chrono::steady_clock::now() < deadline);
+    return false;
+}
+
+/*
+  runs the function loaded by one of the `lua_load()` family, which returned
+  `load_ret`. the error message is on the top of the stack if it failed.
+*/
+static bool RunLoadedChunk(
+    lua_State* l, int load_ret, string* errstr,
     const function<bool(uint32_t, const LuaObject&)>& callback) {
-    bool ok = (luaL_loadstring(m_l, chunk) == LUA_OK);
-    if (!ok) {
+    if (load_ret != LUA_OK) {
         if (errstr) {
-            *errstr = lua_tostring(m_l, -1);
+            *errstr = lua_tostring(l, -1);
         }
-        lua_pop(m_l, 1);
+        lua_pop(l, 1);
         return false;
     }
 
-    LuaFunction f(m_l, -1);
-    ok = f.Execute(callback, errstr);
-    lua_pop(m_l, 1); // function generated by luaL_loadstring()
+    LuaFunction f(l, -1);
+    bool ok = f.Execute(callback, errstr);
+    lua_pop(l, 1); // the loaded function
     return ok;
 }
 
+bool LuaState::DoString(
+    const char* chunk, string* errstr,
+    const function<bool(uint32_t, const LuaObject&)>& callback) {
+    int ret;
+    if (m_chunk_cache.GetCapacity() == 0) {
+        ret = luaL_loadstring(m_l, chunk);
+    } else {
+        ret = m_chunk_cache.Load(m_l, chunk);
+    }
+    return RunLoadedChunk(m_l, ret, errstr, callback);
+}
+
+bool LuaState::SetBytecodeCacheDir(const char* dir, string* errstr) {
+    m_bytecode_cache_dir.clear();
+    if (!dir || dir[0] == '\0') {
+        return true;
+    }
+    if (!CheckBytecodeCacheDir(dir, errstr)) {
+        return false;
+    }
+
+    m_bytecode_cache_dir = dir;
+    return true;
+}
+
 bool LuaState::DoFile(
     const char* script, string* errstr,
     const function<bool(uint32_t, const LuaObject&)>& callback) {
-    bool ok = (luaL_loadfile(m_l, script) == LUA_OK);
+    int ret;
+    if (m_bytecode_cache_dir.empty()) {
+        ret = luaL_loadfile(m_l, script);
+    } else {
+        ret = LoadFileWithBytecodeCache(m_l, script,
+                                        m_bytecode_cache_dir.c_str());
+    }
+    return RunLoadedChunk(m_l, ret, errstr, callback);
+}
+
+/*
+  returns the function loaded by one of the `lua_load()` family, which
+  returned `load_ret`, or a nil object if it failed.
+*/
+static LuaFunction PopLoadedChunk(lua_State* l, int load_ret,
+                                  string* errstr) {
+    if (load_ret != LUA_OK) {
+        if (errstr) {
+            *errstr = lua_tostring(l, -1);
+        }
+        lua_pop(l, 1);
+        lua_pushnil(l);
+    }
+
+    LuaFunction ret(l, -1);
+    lua_pop(l, 1);
+    return ret;
+}
+
+LuaFunction LuaState::LoadBuffer(const char* buf, uint64_t len,
+                                 const char* chunkname, string* errstr) {
+    int ret = luaL_loadbuffer(m_l, buf, len, chunkname);
+    return PopLoadedChunk(m_l, ret, errstr);
+}
+
+static const char* ChunkReaderFunc(lua_State*, void* ud, size_t* size) {
+    auto reader = (const LuaState::ChunkReader*)ud;
+    auto ret = (*reader)(size);
+    if (!ret) {
+        *size = 0;
+    }
+    return ret;
+}
+
+// the buffer is reused for every piece
+struct IstreamReaderData final {
+    istream* is;
+    char buf[16384];
+};
+
+static const char* IstreamReaderFunc(lua_State*, void* ud, size_t* size) {
+    auto data = (IstreamReaderData*)ud;
+    data->is->read(data->buf, sizeof(data->buf));
+    *size = data->is->gcount();
+    return (*size > 0) ? data->buf : nullptr;
+}
+
+/*
+  lua takes a failed read for the end of the chunk, so a stream broken in
+  the middle is reported as an error instead of a truncated chunk.
+*/
+static int LoadIstream(lua_State* l, istream& is, const char* chunkname) {
+    IstreamReaderData data;
+    data.is = &is;
+    int ret = lua_load(l, IstreamReaderFunc, &data, chunkname, nullptr);
+    if (is.bad()) {
+        if (!chunkname) {
+            chunkname = "?";
+        } else if (chunkname[0] == '=' || chunkname[0] == '@') {
+            ++chunkname;
+        }
+        lua_pop(l, 1);
+        lua_pushfstring(l, "cannot read %s", chunkname);
+        ret = LUA_ERRFILE;
+    }
+    return ret;
+}
+
+LuaFunction LuaState::Load(const ChunkReader& reader, const char* chunkname,
+                           string* errstr) {
+    int ret = lua_load(m_l, ChunkReaderFunc, (void*)&reader, chunkname,
+                       nullptr);
+    return PopLoadedChunk(m_l, ret, errstr);
+}
+
+LuaFunction LuaState::Load(istream& is, const char* chunkname,
+                           string* errstr) {
+    int ret = LoadIstream(m_l, is, chunkname);
+    return PopLoadedChunk(m_l, ret, errstr);
+}
+
+bool LuaState::DoStream(
+    const ChunkReader& reader, const char* chunkname, string* errstr,
+    const function<bool(uint32_t, const LuaObject&)>& callback) {
+    int ret = lua_load(m_l, ChunkReaderFunc, (void*)&reader, chunkname,
+                       nullptr);
+    return RunLoadedChunk(m_l, ret, errstr, callback);
+}
+
+bool LuaState::DoStream(
+    istream& is, const char* chunkname, string* errstr,
+    const function<bool(uint32_t, const LuaObject&)>& callback) {
+    int ret = LoadIstream(m_l, is, chunkname);
+    return RunLoadedChunk(m_l, ret, errstr, callback);
+}
+
+// contents of a file mapped into memory, or read into a buffer on Windows
+class MappedFile final {
+public:
+    MappedFile() : m_data(""), m_size(0) {}
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const char* fpath, string* errstr);
+
+    const char* GetData() const {
+        return m_data;
+    }
+    uint64_t GetSize() const {
+        return m_size;
+    }
+
+private:
+    const char* m_data;
+    uint64_t m_size;
+#ifdef _WIN32
+    string m_buf;
+#endif
+};
+
+#ifdef _WIN32
+MappedFile::~MappedFile() {}
+
+bool MappedFile::Open(const char* fpath, string* errstr) {
+    FILE* fp = fopen(fpath, "rb");
+    if (!fp) {
+        if (errstr) {
+            *errstr = string("cannot open ") + fpath + ": " + strerror(errno);
+        }
+        return false;
+    }
+
+    char buf[16384];
+    while (true) {
+        auto n = fread(buf, 1, sizeof(buf), fp);
+        if (n == 0) {
+            break;
+        }
+        m_buf.append(buf, n);
+    }
+
+    bool ok = !ferror(fp);
+    fclose(fp);
     if (!ok) {
         if (errstr) {
-            *errstr = lua_tostring(m_l, -1);
+            *errstr = string("cannot read ") + fpath;
         }
-        lua_pop(m_l, 1);
         return false;
     }
 
-    LuaFunction f(m_l, -1);
-    ok = f.Execute(callback, errstr);
-    lua_pop(m_l, 1); // function generated by luaL_loadfile()
-    return ok;
+    m_data = m_buf.data();
+    m_size = m_buf.size();
+    return true;
+}
+#else
+MappedFile::~MappedFile() {
+    if (m_size > 0) {
+        munmap((void*)m_data, m_size);
+    }
+}
+
+bool MappedFile::Open(const char* fpath, string* errstr) {
+    // does not wait for writers of fifos, which are rejected below
+    int fd = open(fpath, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        if (errstr) {
+            *errstr = string("cannot open ") + fpath + ": " + strerror(errno);
+        }
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        if (errstr) {
+            *errstr = string("cannot stat ") + fpath + ": " + strerror(errno);
+        }
+        close(fd);
+        return false;
+    }
+
+    // fifos and devices report no size and cannot be mapped
+    if (!S_ISREG(st.st_mode)) {
+        if (errstr) {
+            *errstr = string("cannot load ") + fpath + ": not a regular file";
+        }
+        close(fd);
+        return false;
+    }
+
+    if (st.st_size > 0) {
+        auto addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            if (errstr) {
+                *errstr =
+                    string("cannot mmap ") + fpath + ": " + strerror(errno);
+            }
+            close(fd);
+            return false;
+        }
+        m_data = (const char*)addr;
+        m_size = st.st_size;
+    }
+
+    close(fd);
+    return true;
+}
+#endif
+
+bool LuaState::DoMapped(
+    const char* script, string* errstr,
+    const function<bool(uint32_t, const LuaObject&)>& callback) {
+    MappedFile file;
+    if (!file.Open(script, errstr)) {
+        return false;
+    }
+
+    uint64_t len = file.GetSize();
+    const char* data = SkipComment(file.GetData(), &len);
+
+    // lua does not refer to the buffer after loading
+    int ret = luaL_loadbuffer(m_l, data, len,
+                              (string("@") + script).c_str());
+    return RunLoadedChunk(m_l, ret, errstr, callback);
 }
 
 }
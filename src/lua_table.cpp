@@ -23,6 +23,22 @@ LuaStringRef LuaTable::GetStringRef(const char* name) const {
     return LuaStringRef(str, len);
 }
 
+LuaStringRef LuaTable::GetStringRef(const LuaKey& key) const {
+    PushRawField(key);
+    size_t len = 0;
+    const char* str = lua_tolstring(m_l, -1, &len);
+    lua_pop(m_l, 2);
+    return LuaStringRef(str, len);
+}
+
+LuaStringRef LuaTable::GetStringRef(const LuaPath& path) const {
+    PushPathValue(path);
+    size_t len = 0;
+    const char* str = lua_tolstring(m_l, -1, &len);
+    lua_pop(m_l, 2);
+    return LuaStringRef(str, len);
+}
+
 const char* LuaTable::GetString(int index) const {
     PushSelf();
     lua_rawgeti(m_l, -1, index);
@@ -39,6 +55,20 @@ const char* LuaTable::GetString(const char* name) const {
     return str;
 }
 
+const char* LuaTable::GetString(const LuaKey& key) const {
+    PushRawField(key);
+    const char* str = lua_tostring(m_l, -1);
+    lua_pop(m_l, 2);
+    return str;
+}
+
+const char* LuaTable::GetString(const LuaPath& path) const {
+    PushPathValue(path);
+    const char* str = lua_tostring(m_l, -1);
+    lua_pop(m_l, 2);
+    return str;
+}
+
 lua_Number LuaTable::GetNumber(int index) const {
     PushSelf();
     lua_rawgeti(m_l, -1, index);
@@ -55,6 +85,20 @@ lua_Number LuaTable::GetNumber(const char* name) const {
     return n;
 }
 
+lua_Number LuaTable::GetNumber(const LuaKey& key) const {
+    PushRawField(key);
+    lua_Number n = lua_tonumber(m_l, -1);
+    lua_pop(m_l, 2);
+    return n;
+}
+
+lua_Number LuaTable::GetNumber(const LuaPath& path) const {
+    PushPathValue(path);
+    lua_Number n = lua_tonumber(m_l, -1);
+    lua_pop(m_l, 2);
+    return n;
+}
+
 lua_Integer LuaTable::GetInteger(int index) const {
     PushSelf();
     lua_rawgeti(m_l, -1, index);
@@ -71,6 +115,20 @@ lua_Integer LuaTable::GetInteger(const char* name) const {
     return n;
 }
 
+lua_Integer LuaTable::GetInteger(const LuaKey& key) const {
+    PushRawField(key);
+    lua_Integer n = lua_tointeger(m_l, -1);
+    lua_pop(m_l, 2);
+    return n;
+}
+
+lua_Integer LuaTable::GetInteger(const LuaPath& path) const {
+    PushPathValue(path);
+    lua_Integer n = lua_tointeger(m_l, -1);
+    lua_pop(m_l, 2);
+    return n;
+}
+
 void* LuaTable::GetPointer(int index) const {
     PushSelf();
     lua_rawgeti(m_l, -1, index);
@@ -87,6 +145,20 @@ void* LuaTable::GetPointer(const char* name) const {
     return ptr;
 }
 
+void* LuaTable::GetPointer(const LuaKey& key) const {
+    PushRawField(key);
+    void* ptr = lua_touserdata(m_l, -1);
+    lua_pop(m_l, 2);
+    return ptr;
+}
+
+void* LuaTable::GetPointer(const LuaPath& path) const {
+    PushPathValue(path);
+    void* ptr = lua_touserdata(m_l, -1);
+    lua_pop(m_l, 2);
+    return ptr;
+}
+
 // ----- setters ----- //
 
 void LuaTable::Set(int index, const LuaRefObject& lobj) {
@@ -103,6 +175,14 @@ void LuaTable::Set(const char* name, const LuaRefObject& lobj) {
     lua_pop(m_l, 1);
 }
 
+void LuaTable::Set(const LuaKey& key, const LuaRefObject& lobj) {
+    PushSelf();
+    PushValue(m_l, key);
+    PushValue(m_l, lobj);
+    lua_rawset(m_l, -3);
+    lua_pop(m_l, 1);
+}
+
 void LuaTable::SetString(int index, const char* str) {
     PushSelf();
     lua_pushstring(m_l, str);
@@ -131,6 +211,22 @@ void LuaTable::SetString(const char* name, const char* str, uint64_t len) {
     lua_pop(m_l, 1);
 }
 
+void LuaTable::SetString(const LuaKey& key, const char* str) {
+    PushSelf();
+    PushValue(m_l, key);
+    lua_pushstring(m_l, str);
+    lua_rawset(m_l, -3);
+    lua_pop(m_l, 1);
+}
+
+void LuaTable::SetString(const LuaKey& key, const char* str, uint64_t len) {
+    PushSelf();
+    PushValue(m_l, key);
+    lua_pushlstring(m_l, str, len);
+    lua_rawset(m_l, -3);
+    lua_pop(m_l, 1);
+}
+
 void LuaTable::SetNumber(int index, lua_Number value) {
     PushSelf();
     lua_pushnumber(m_l, value);
@@ -145,6 +241,14 @@ void LuaTable::SetNumber(const char* name, lua_Number value) {
     lua_pop(m_l, 1);
 }
 
+void LuaTable::SetNumber(const LuaKey& key, lua_Number value) {
+    PushSelf();
+    PushValue(m_l, key);
+    lua_pushnumber(m_l, value);
+    lua_rawset(m_l, -3);
+    lua_pop(m_l, 1);
+}
+
 void LuaTable::SetInteger(int index, lua_Integer value) {
     PushSelf();
     lua_pushinteger(m_l, value);
@@ -159,6 +263,14 @@ void LuaTable::SetInteger(const char* name, lua_Integer value) {
     lua_pop(m_l, 1);
 }
 
+void LuaTable::SetInteger(const LuaKey& key, lua_Integer value) {
+    PushSelf();
+    PushValue(m_l, key);
+    lua_pushinteger(m_l, value);
+    lua_rawset(m_l, -3);
+    lua_pop(m_l, 1);
+}
+
 void LuaTable::SetPointer(int index, void* ptr) {
     PushSelf();
     lua_pushlightuserdata(m_l, ptr);
@@ -173,4 +285,12 @@ void LuaTable::SetPointer(const char* name, void* ptr) {
     lua_pop(m_l, 1);
 }
 
+void LuaTable::SetPointer(const LuaKey& key, void* ptr) {
+    PushSelf();
+    PushValue(m_l, key);
+    lua_pushlightuserdata(m_l, ptr);
+    lua_rawset(m_l, -3);
+    lua_pop(m_l, 1);
+}
+
 }
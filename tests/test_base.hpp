@@ -1,4 +1,14 @@
 #include <iostream>
+#include <vector>
+#include <sstream>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
 #include "luacpp/luacpp.h"
 #include "test_common.h"
 using namespace luacpp;
@@ -56,6 +66,153 @@ static void TestString() {
     assert(string(buf2.base, buf2.size) == var);
 }
 
+static void TestInlineScalars() {
+    auto raw = luaL_newstate();
+    LuaState l(raw, true);
+
+    int dummy = 0;
+    auto lint = l.CreateInteger(5, "i");
+    auto lnum = l.CreateNumber(2.5, "n");
+    auto lptr = l.CreatePointer(&dummy, "p");
+    l.DoString("b = false; s = '12'");
+
+    // scalars are stored without references
+    assert(lint.GetRefIndex() == LUA_REFNIL);
+    assert(lnum.GetRefIndex() == LUA_REFNIL);
+    assert(lptr.GetRefIndex() == LUA_REFNIL);
+    assert(l.Get("b").GetRefIndex() == LUA_REFNIL);
+    assert(l.Get("s").GetRefIndex() != LUA_REFNIL);
+
+    assert(lint.ToInteger() == 5);
+    assert(lint.ToNumber() == 5.0);
+    assert(lint.ToBool());
+    assert(lnum.ToNumber() == 2.5);
+    assert(lnum.ToInteger() == 0); // not an integral value
+    assert(l.CreateNumber(4.0).ToInteger() == 4);
+    assert(lptr.ToPointer() == &dummy);
+    assert(!l.Get("b").ToBool());
+    assert(l.Get("b").GetType() == LUA_TBOOLEAN);
+    assert(!l.CreateNil().ToBool());
+    assert(l.Get("s").ToInteger() == 12);
+
+    // copies and integer/float subtypes are kept
+    auto lint2 = lint;
+    LuaObject lnum2(l.CreateInteger(0));
+    lnum2 = lnum;
+    auto tbl = l.CreateTable("t");
+    tbl.Set("i", lint2);
+    tbl.Set("n", lnum2);
+    tbl.Set("b", l.Get("b"));
+    string errmsg;
+    bool ok = l.DoString("assert(math.type(t.i) == 'integer' and t.i == 5); "
+                         "assert(math.type(t.n) == 'float' and t.n == 2.5); "
+                         "assert(t.b == false)",
+                         &errmsg);
+    assert(ok);
+    assert(lua_gettop(raw) == 0);
+}
+
+static void TestSharedReferences() {
+    LuaState l(luaL_newstate(), true);
+
+    int ref_index = LUA_REFNIL;
+    {
+        auto tbl = l.CreateTable();
+        tbl.SetInteger("x", 5);
+        ref_index = tbl.GetRefIndex();
+
+        // copies share the same reference
+        vector<LuaTable> copies(3, tbl);
+        for (auto& t : copies) {
+            assert(t.GetRefIndex() == ref_index);
+        }
+        auto assigned = l.CreateTable();
+        assigned = copies[0];
+        assert(assigned.GetRefIndex() == ref_index);
+
+        // moved objects keep the reference
+        LuaTable moved(std::move(copies[1]));
+        assert(moved.GetRefIndex() == ref_index);
+
+        {
+            LuaTable tbl2(tbl);
+            tbl = l.CreateTable();
+            assert(tbl.GetRefIndex() != ref_index);
+        }
+        copies.clear();
+        assert(moved.GetInteger("x") == 5);
+        assert(assigned.GetInteger("x") == 5);
+    }
+
+    // the reference is released with the last copy and reused by `luaL_ref()`
+    auto tbl = l.CreateTable();
+    auto tbl2 = l.CreateTable();
+    assert(tbl.GetRefIndex() == ref_index || tbl2.GetRefIndex() == ref_index);
+}
+
+static void TestScope() {
+    auto raw = luaL_newstate();
+    LuaState l(raw, true);
+    l.DoString("t = {'a', 'b', 'c', sub = {x = 5}}");
+
+    int ref_index = LUA_REFNIL;
+    {
+        auto tmp = l.CreateTable();
+        ref_index = tmp.GetRefIndex();
+    }
+
+    {
+        LuaScope scope(l);
+        auto tbl = scope.Get<LuaTable>(l, "t");
+        assert(scope.GetSize() == 1);
+
+        string s;
+        for (int i = 1; i <= 3; ++i) {
+            auto lobj = scope.Get(tbl, i);
+            auto buf = lobj.ToStringRef();
+            s.append(buf.base, buf.size);
+        }
+        assert(s == "abc");
+        assert(scope.GetSize() == 4);
+
+        // scalars are not stored in scopes
+        LuaPath path;
+        bool ok = l.CreatePath("sub.x", &path);
+        assert(ok);
+        auto x = scope.Get(tbl, path);
+        assert(x.ToInteger() == 5);
+        assert(scope.GetSize() == 4);
+
+        {
+            LuaScope inner(l);
+            auto sub = inner.Get<LuaTable>(tbl, "sub");
+            auto copy = sub;
+            assert(copy.GetInteger("x") == 5);
+            assert(inner.GetSize() == 1);
+            assert(scope.GetSize() == 4);
+        }
+
+        tbl.PushTo(raw);
+        auto top = scope.Create<LuaTable>(-1);
+        lua_pop(raw, 1);
+        assert(top.GetTable("sub").GetInteger("x") == 5);
+        assert(scope.GetSize() == 5);
+    }
+
+    // no references were created in the registry
+    auto tmp = l.CreateTable();
+    assert(tmp.GetRefIndex() == ref_index);
+
+    // objects not created by scopes are still valid after scopes are destroyed
+    LuaTable sub(raw);
+    {
+        LuaScope scope(l);
+        sub = scope.Get<LuaTable>(l, "t").GetTable("sub");
+        assert(scope.GetSize() == 1);
+    }
+    assert(sub.GetInteger("x") == 5);
+}
+
 static void TestTable() {
     LuaState l(luaL_newstate(), true);
 
@@ -162,6 +319,48 @@ static void TestTableGetSet() {
     assert(ret_msg == msg);
 }
 
+static void TestTableArray() {
+    LuaState l(luaL_newstate(), true);
+
+    const vector<double> numbers = {1.5, 2.5, 3.5};
+    auto ltable = l.CreateArray(numbers, "numbers");
+    assert(ltable.GetSize() == 3);
+    assert(ltable.GetNumber(2) == 2.5);
+
+    string errmsg;
+    bool ok = l.DoString(
+        "assert(#numbers == 3 and numbers[3] == 3.5);"
+        "strs = {'a', 'bc', 'def'}",
+        &errmsg);
+    assert(ok);
+    assert(errmsg.empty());
+
+    assert(ltable.ToVector<double>() == numbers);
+
+    const int src[3] = {1, 2, 3};
+    auto lints = l.CreateArray(src, 3);
+    int ints[5] = {0};
+    assert(lints.CopyTo(ints, 2) == 2);
+    assert(ints[0] == 1 && ints[1] == 2 && ints[2] == 0);
+    assert(lints.CopyTo(ints, 5) == 3);
+    assert(ints[2] == 3);
+
+    auto strs = l.GetTable("strs").ToVector<string>();
+    assert(strs == vector<string>({"a", "bc", "def"}));
+
+    const char* cstrs[] = {"x", "yz"};
+    auto lstrs = l.CreateArray(cstrs, 2);
+    assert(string(lstrs.GetString(2)) == "yz");
+    assert(l.CreateArray(strs).ToVector<string>() == strs);
+
+    // string refs need not be null-terminated
+    const char* buf = "abcdef";
+    const LuaStringRef refs[] = {LuaStringRef(buf, 2),
+                                 LuaStringRef(buf + 3, 3)};
+    auto lrefs = l.CreateArray(refs, 2);
+    assert(lrefs.ToVector<string>() == vector<string>({"ab", "def"}));
+}
+
 static void TestFuncWithReturnValue() {
     LuaState l(luaL_newstate(), true);
 
@@ -210,6 +409,348 @@ static void TestFuncWithReturnValue() {
             nullptr, 5, msg2.c_str());
 }
 
+static void TestFuncWithTypedResults() {
+    LuaState l(luaL_newstate(), true);
+
+    string errmsg;
+    bool ok = l.DoString(
+        "function multi(a, b) return a + b, a * 1.5, 'ouonline', {} end;"
+        "function fail() error('failed') end",
+        &errmsg);
+    assert(ok);
+
+    auto lfunc = l.GetFunction("multi");
+
+    std::tuple<int, double, string> res;
+    ok = lfunc.Call(&res, &errmsg, 2, 3);
+    assert(ok);
+    assert(std::get<0>(res) == 5);
+    assert(std::get<1>(res) == 3.0);
+    assert(std::get<2>(res) == "ouonline");
+
+    // missing results are nil
+    std::tuple<int, double, string, LuaTable, int> res2(
+        0, 0, "", l.CreateTable(), 42);
+    ok = l.Call("multi", &res2, &errmsg, 1, 1);
+    assert(ok);
+    assert(std::get<0>(res2) == 2);
+    assert(std::get<3>(res2).GetType() == LUA_TTABLE);
+    assert(std::get<4>(res2) == 0);
+
+    std::tuple<int> res3;
+    ok = l.Call("fail", &res3, &errmsg);
+    assert(!ok);
+    assert(errmsg.find("failed") != string::npos);
+
+    errmsg.clear();
+    ok = l.Call("not_exist", &res3, &errmsg);
+    assert(!ok);
+    assert(!errmsg.empty());
+}
+
+static void TestTableForEachPrimitives() {
+    auto raw = luaL_newstate();
+    LuaState l(raw, true);
+
+    l.DoString("arr = {10, 20, 30}; "
+               "dict = {a = 1.5, b = 2.5, [3] = true, [4] = false}");
+    auto arr = l.GetTable("arr");
+
+    lua_Integer sum = 0;
+    bool ok = arr.ForEach([&sum](uint32_t i, lua_Integer value) -> bool {
+        assert(value == (lua_Integer)(i + 1) * 10);
+        sum += value;
+        return true;
+    });
+    assert(ok);
+    assert(sum == 60);
+
+    // stops at the second element
+    uint32_t visited = 0;
+    ok = arr.ForEach([&visited](uint32_t i, double) -> bool {
+        ++visited;
+        return (i == 0);
+    });
+    assert(!ok);
+    assert(visited == 2);
+
+    auto dict = l.GetTable("dict");
+    double fsum = 0;
+    uint32_t true_count = 0, false_count = 0;
+    ok = dict.ForEach(
+        [&](const LuaObject& key, const LuaObject& value) -> bool {
+            if (key.GetType() == LUA_TSTRING) {
+                fsum += value.ToNumber();
+            } else if (value.ToBool()) {
+                ++true_count;
+            } else {
+                ++false_count;
+            }
+            return true;
+        });
+    assert(ok);
+    assert(fsum == 4.0);
+    assert(true_count == 1 && false_count == 1);
+
+    // numeric keys converted to strings must not break `lua_next()`
+    string keys;
+    ok = arr.ForEach([&keys](LuaStringRef key, lua_Integer) -> bool {
+        keys.append(key.base, key.size);
+        return true;
+    });
+    assert(ok);
+    assert(keys == "123");
+    assert(lua_type(raw, -1) != LUA_TSTRING);
+
+    ok = dict.ForEach([&true_count](lua_Integer key, bool value) -> bool {
+        if (key == 3) {
+            assert(value);
+            --true_count;
+        }
+        return true;
+    });
+    assert(ok);
+    assert(true_count == 0);
+
+    // the same callbacks on a stack table
+    auto lfunc = l.CreateFunction([](LuaStackTable tbl) -> lua_Integer {
+        lua_Integer total = 0;
+        tbl.ForEach([&total](uint32_t, lua_Integer value) -> bool {
+            total += value;
+            return true;
+        });
+        return total;
+    });
+
+    std::tuple<lua_Integer> res;
+    ok = lfunc.Call(&res, nullptr, arr);
+    assert(ok);
+    assert(std::get<0>(res) == 60);
+    assert(lua_gettop(raw) == 0);
+}
+
+static void TestTableKey() {
+    LuaState l(luaL_newstate(), true);
+
+    auto kname = l.CreateKey("name");
+    auto kcount = l.CreateKey("count");
+    auto kratio = l.CreateKey("ratio", 5);
+    auto kmissing = l.CreateKey("missing");
+
+    auto tbl = l.CreateTable("tbl");
+    tbl.SetString(kname, "ouonline");
+    tbl.SetInteger(kcount, 5);
+    tbl.SetNumber(kratio, 0.5);
+
+    auto buf = tbl.GetStringRef(kname);
+    assert(string(buf.base, buf.size) == "ouonline");
+    assert(string(tbl.GetString("name")) == "ouonline");
+    assert(tbl.GetInteger(kcount) == 5);
+    assert(tbl.GetNumber(kratio) == 0.5);
+
+    // keys are looked up without metamethods
+    string errmsg;
+    bool ok = l.DoString(
+        "setmetatable(tbl, {__index = function() return 100 end})", &errmsg);
+    assert(ok);
+    assert(tbl.GetInteger("missing") == 100);
+    assert(tbl.Get(kmissing).GetType() == LUA_TNIL);
+
+    auto sub = l.CreateTable();
+    sub.SetInteger(kcount, 8);
+    tbl.Set(kname, sub);
+    assert(tbl.GetTable(kname).GetInteger(kcount) == 8);
+
+    // globals
+    l.Set(kcount, l.CreateInteger(3));
+    assert(l.GetInteger("count") == 3);
+    assert(l.GetInteger(kcount) == 3);
+    assert(l.GetTable(l.CreateKey("tbl")).GetNumber(kratio) == 0.5);
+
+    l.CreateFunction(
+        [&](const LuaStackTable& st) -> lua_Integer {
+            return st.GetInteger(kcount) +
+                st.GetTable(kname).GetInteger(kcount);
+        },
+        "sum");
+    ok = l.DoString("res = sum(tbl)", &errmsg);
+    assert(ok);
+    assert(l.GetInteger("res") == 13);
+}
+
+static void TestTableCursor() {
+    auto raw = luaL_newstate();
+    LuaState l(raw, true);
+
+    auto tbl = l.CreateTable("tbl");
+    auto kcount = l.CreateKey("count");
+    {
+        auto cursor = tbl.Pin();
+        assert(lua_gettop(raw) == 1);
+        cursor.SetString("name", "ouonline");
+        cursor.SetInteger(kcount, 5);
+        cursor.SetNumber(1, 0.5);
+        cursor.Set("sub", l.CreateTable());
+        assert(cursor.GetSize() == 1);
+
+        {
+            auto sub = cursor.PinTable("sub");
+            assert(lua_gettop(raw) == 2);
+            sub.SetInteger("x", 3);
+            sub.SetInteger(kcount, 8);
+        }
+        assert(lua_gettop(raw) == 1);
+
+        // moved cursors do not pop the stack twice
+        auto sub = cursor.PinTable(l.CreateKey("sub"));
+        auto moved(std::move(sub));
+        assert(moved.GetInteger("x") == 3);
+        assert(moved.IsValid());
+        assert(lua_gettop(raw) == 2);
+    }
+    assert(lua_gettop(raw) == 0);
+
+    {
+        // non-table values are pinned as nil
+        auto cursor = tbl.Pin();
+        auto name = cursor.PinTable("name");
+        assert(!name.IsValid());
+        assert(name.GetType() == LUA_TNIL);
+        auto none = cursor.PinTable(100);
+        assert(!none.IsValid());
+        assert(lua_gettop(raw) == 3);
+    }
+    assert(lua_gettop(raw) == 0);
+
+    assert(string(tbl.GetString("name")) == "ouonline");
+    assert(tbl.GetInteger("count") == 5);
+    assert(tbl.GetNumber(1) == 0.5);
+    assert(tbl.GetTable("sub").GetInteger("count") == 8);
+
+    string errmsg;
+    bool ok = l.DoString("arr = {{1, 2}, {3, 4}}", &errmsg);
+    assert(ok);
+    auto cursor = l.GetTable("arr").Pin();
+    lua_Integer sum = 0;
+    for (int i = 1; i <= 2; ++i) {
+        auto item = cursor.PinTable(i);
+        sum += item.GetInteger(1) * item.GetInteger(2);
+    }
+    assert(sum == 14);
+}
+
+static void TestTablePath() {
+    auto raw = luaL_newstate();
+    LuaState l(raw, true);
+
+    string errmsg;
+    bool ok = l.DoString("cfg = {upstream = {pool = {max_conns = 64}, "
+                         "servers = {{host = 'a'}, {host = 'b', "
+                         "['the port'] = 8080}}}}",
+                         &errmsg);
+    assert(ok);
+
+    LuaPath path;
+    ok = l.CreatePath("cfg.upstream.pool.max_conns", &path, &errmsg);
+    assert(ok);
+    assert(path.GetDepth() == 4);
+    assert(l.GetInteger(path) == 64);
+    assert(lua_gettop(raw) == 0);
+
+    ok = l.CreatePath("upstream.servers[2]['the port']", &path, &errmsg);
+    assert(ok);
+    auto cfg = l.GetTable("cfg");
+    assert(cfg.GetInteger(path) == 8080);
+
+    ok = l.CreatePath("[\"upstream\"].servers[1].host", &path, &errmsg);
+    assert(ok);
+    assert(string(cfg.GetString(path)) == "a");
+    assert(cfg.Get(path).GetType() == LUA_TSTRING);
+
+    ok = l.CreatePath("upstream.pool", &path, &errmsg);
+    assert(ok);
+    assert(cfg.GetTable(path).GetInteger("max_conns") == 64);
+
+    // missing or non-table intermediate values result in nil
+    ok = l.CreatePath("cfg.upstream.pool.max_conns.x", &path, &errmsg);
+    assert(ok);
+    assert(l.Get(path).GetType() == LUA_TNIL);
+    ok = l.CreatePath("cfg.downstream.pool", &path, &errmsg);
+    assert(ok);
+    assert(l.Get(path).GetType() == LUA_TNIL);
+    assert(lua_gettop(raw) == 0);
+
+    const char* invalid_paths[] = {"", "a..b", "a.[1]", "1a", "a[x]",
+                                   "a['b]", "a b"};
+    for (auto p : invalid_paths) {
+        errmsg.clear();
+        ok = l.CreatePath(p, &path, &errmsg);
+        assert(!ok);
+        assert(!errmsg.empty());
+        assert(path.GetDepth() == 0);
+    }
+}
+
+static void TestFuncForEachCall() {
+    LuaState l(luaL_newstate(), true);
+
+    string errmsg;
+    bool ok = l.DoString(
+        "function on_record(id, name)"
+        "  if id == 3 then error('bad record') end;"
+        "  return id * 2, 'name-' .. name "
+        "end;"
+        "function double(v) return v * 2 end",
+        &errmsg);
+    assert(ok);
+
+    auto lfunc = l.GetFunction("on_record");
+    const vector<pair<int, string>> records = {
+        {1, "a"}, {2, "b"}, {3, "c"}, {4, "d"}};
+
+    vector<int> ids;
+    vector<string> names;
+    vector<uint64_t> failed;
+    auto count = lfunc.ForEachCall(
+        records,
+        [](const pair<int, string>& rec) -> std::tuple<int, const char*> {
+            return std::make_tuple(rec.first, rec.second.c_str());
+        },
+        [&ids, &names](uint64_t, int id, LuaStringRef name) -> bool {
+            ids.push_back(id);
+            names.push_back(string(name.base, name.size));
+            return true;
+        },
+        [&failed](uint64_t i, const char* msg) -> bool {
+            assert(string(msg).find("bad record") != string::npos);
+            assert(string(msg).find("stack traceback") != string::npos);
+            failed.push_back(i);
+            return true;
+        });
+    assert(count == 4);
+    assert(ids == vector<int>({2, 4, 8}));
+    assert(names.back() == "name-d");
+    assert(failed == vector<uint64_t>({2}));
+
+    // stops when the sink returns false
+    count = l.GetFunction("double").ForEachCall(
+        vector<int>({1, 2, 4}),
+        [](int v) -> int {
+            return v;
+        },
+        [](uint64_t i, int res) -> bool {
+            assert(res == 2 || res == 4);
+            return (i < 1);
+        });
+    assert(count == 2);
+
+    // the stack is balanced
+    std::tuple<int> res;
+    ok = lfunc.Call(&res, &errmsg, 5, "e");
+    assert(ok);
+    assert(std::get<0>(res) == 10);
+}
+
 static void GlobalEcho(const char* msg) {
     cout << msg << endl;
 }
@@ -272,6 +813,29 @@ static void TestFuncWithPointerToBasicTypes() {
     assert(v == 456);
 }
 
+static void TestFuncWithStackViews() {
+    LuaState l(luaL_newstate(), true);
+    l.CreateFunction(
+        [](const LuaStackTable& tbl, const LuaStackObject& lobj) -> int {
+            assert(tbl.GetType() == LUA_TTABLE);
+            assert(tbl.GetSize() == 2);
+            assert(tbl.GetInteger(1) == 5);
+            auto buf = tbl.GetStringRef("name");
+            assert(string(buf.base, buf.size) == "ouonline");
+            assert(lobj.GetType() == LUA_TNUMBER);
+            assert(lobj.ToInteger() == 3);
+            return (int)(tbl.GetInteger(2) + lobj.ToInteger());
+        },
+        "StackViews");
+
+    string errmsg;
+    bool ok = l.DoString(
+        "t = {5, 8, name = 'ouonline'}; res = StackViews(t, 3)", &errmsg);
+    assert(ok);
+    assert(errmsg.empty());
+    assert(l.GetInteger("res") == 11);
+}
+
 static int variadic_argument_func_demo(lua_State* l) {
     cout << "get argc = " << lua_gettop(l) << endl;
     return 0;
@@ -293,6 +857,55 @@ static void TestVariadicArguments() {
     assert(errmsg.empty());
 }
 
+static void TestLuaStyleLambda() {
+    LuaState l(luaL_newstate(), true);
+
+    // captureless lambdas with the signature of `lua_CFunction` are exported
+    // as lua-style functions
+    l.CreateFunction(
+        [](lua_State* l) -> int {
+            lua_pushinteger(l, lua_gettop(l));
+            return 1;
+        },
+        "ArgCount");
+
+    string errmsg;
+    bool ok = l.DoString("assert(ArgCount(1, 'a', {}) == 3)", &errmsg);
+    assert(ok);
+    assert(errmsg.empty());
+
+    // lambdas with captures are stored as they are
+    string prefix = "luacpp-";
+    l.CreateFunction(
+        [prefix](const char* s) -> LuaStringRef {
+            static string res;
+            res = prefix + s;
+            return LuaStringRef(res.data(), res.size());
+        },
+        "AddPrefix");
+    ok = l.DoString("assert(AddPrefix('lambda') == 'luacpp-lambda')", &errmsg);
+    assert(ok);
+    assert(errmsg.empty());
+}
+
+static void TestStaticBoundFunction() {
+    LuaState l(luaL_newstate(), true);
+
+    l.CreateFunction<decltype(&ReturnSelf<const char*>),
+                     &ReturnSelf<const char*>>("ReturnSelf");
+    l.CreateFunction<decltype(&variadic_argument_func_demo),
+                     &variadic_argument_func_demo>("VariadicFunc");
+
+    string errmsg;
+    bool ok = l.DoString(
+        "assert(ReturnSelf('static') == 'static'); VariadicFunc(1, 'a');"
+        // no upvalues are created
+        "assert(debug.getupvalue(ReturnSelf, 1) == nil)",
+        &errmsg);
+    assert(ok);
+    assert(errmsg.empty());
+}
+
 static void TestUserdata1() {
     LuaState l(luaL_newstate(), true);
 
@@ -352,3 +965,677 @@ static void TestDoFile() {
     assert(!errstr.empty());
     cerr << "errmsg -> " << errstr << endl;
 }
+
+static void TestSlabAllocator() {
+    LuaState normal(luaL_newstate(), true);
+    assert(!normal.GetAllocator<LuaSlabAllocator>());
+
+    auto lp = LuaState::NewWithSlabAllocator();
+    assert(lp);
+    auto& l = *lp;
+    auto allocator = l.GetAllocator<LuaSlabAllocator>();
+    assert(allocator);
+
+    string errmsg;
+    bool ok = l.DoString("t = {}; for i = 1, 1000 do "
+                         "t[i] = {name = 'item' .. i, f = function() end} end; "
+                         "s = string.rep('x', 10000)",
+                         &errmsg);
+    assert(ok);
+
+    LuaSlabAllocator::Stats stats;
+    allocator->GetStats(&stats);
+    assert(!stats.size_classes.empty());
+    assert(stats.large_blocks > 0);
+    assert(stats.large_bytes >= 10000);
+    assert(stats.fragmentation >= 0 && stats.fragmentation < 1);
+
+    uint64_t used_blocks = 0;
+    for (auto& cls : stats.size_classes) {
+        assert(cls.block_size % 16 == 0);
+        assert(cls.used_blocks <= cls.total_blocks);
+        assert(cls.requested_bytes <= cls.used_blocks * cls.block_size);
+        used_blocks += cls.used_blocks;
+    }
+    assert(used_blocks > 3000);
+
+    // freed blocks are reused
+    ok = l.DoString("t = nil; s = nil; collectgarbage()", &errmsg);
+    assert(ok);
+    LuaSlabAllocator::Stats stats2;
+    allocator->GetStats(&stats2);
+    assert(stats2.slab_bytes == stats.slab_bytes);
+    assert(stats2.large_bytes < stats.large_bytes);
+    used_blocks = 0;
+    for (auto& cls : stats2.size_classes) {
+        used_blocks += cls.used_blocks;
+    }
+    assert(used_blocks < 3000);
+
+#if LUA_VERSION_NUM >= 504
+    // warnings are off by default like `luaL_newstate()`
+    ok = l.DoString("warn('ignored'); warn('@on'); warn('@off')", &errmsg);
+    assert(ok);
+#endif
+
+    // moved states keep the allocator
+    LuaState moved(std::move(l));
+    assert(moved.GetAllocator<LuaSlabAllocator>() == allocator);
+    assert(moved.DoString("t = {1, 2, 3}"));
+}
+
+static void* volatile g_exhausted_block;
+
+// uses up memory so that no chunk or slab can be allocated
+static bool ExhaustMemory() {
+    unsigned long pages = 0;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (!fp) {
+        return false;
+    }
+    int n = fscanf(fp, "%lu", &pages);
+    fclose(fp);
+    if (n != 1) {
+        return false;
+    }
+
+    struct rlimit rl;
+    getrlimit(RLIMIT_AS, &rl);
+    rl.rlim_cur = pages * sysconf(_SC_PAGESIZE) + 16 * 1024 * 1024;
+    if (setrlimit(RLIMIT_AS, &rl) != 0) {
+        return false;
+    }
+
+    do {
+        g_exhausted_block = malloc(4096);
+    } while (g_exhausted_block);
+    return true;
+}
+
+// runs `func` in a child process, which may exhaust memory
+static void RunInChild(int (*func)()) {
+#ifdef __SANITIZE_ADDRESS__
+    // the sanitizer reserves huge address space and aborts on failures
+    (void)func;
+    return;
+#endif
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        _exit(func());
+    }
+
+    int status = 0;
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status));
+    assert(WEXITSTATUS(status) == 0);
+}
+
+static int SlabAllocatorShrinkWithoutMemory() {
+    LuaSlabAllocator allocator;
+    auto alloc = allocator.GetAllocFunc();
+    LuaSlabAllocator::Stats stats;
+    allocator.GetStats(&stats); // reserves space for stats
+
+    auto large = (char*)alloc(&allocator, nullptr, 0, 1024);
+    auto medium = (char*)alloc(&allocator, nullptr, 0, 500);
+    if (!large || !medium) {
+        return 1;
+    }
+    memset(large, 'x', 1024);
+    memset(medium, 'y', 500);
+
+    if (!ExhaustMemory()) {
+        return 2;
+    }
+
+    // shrinking keeps blocks in place
+    if (alloc(&allocator, large, 1024, 16) != large ||
+        alloc(&allocator, medium, 500, 32) != medium) {
+        return 3;
+    }
+    if (large[15] != 'x' || medium[31] != 'y') {
+        return 4;
+    }
+
+    // growing still fails
+    if (alloc(&allocator, nullptr, 0, 64)) {
+        return 5;
+    }
+
+    // blocks are freed with their new sizes
+    alloc(&allocator, large, 16, 0);
+    alloc(&allocator, medium, 32, 0);
+    allocator.GetStats(&stats);
+    if (stats.large_blocks != 0) {
+        return 6;
+    }
+    for (auto& cls : stats.size_classes) {
+        if (cls.used_blocks != 0 || cls.requested_bytes != 0) {
+            return 7;
+        }
+    }
+    return 0;
+}
+
+static void TestSlabAllocatorShrink() {
+    RunInChild(SlabAllocatorShrinkWithoutMemory);
+}
+
+static void TestMemoryLimit() {
+    LuaState normal(luaL_newstate(), true);
+    assert(!normal.GetAllocator<LuaMemoryLimitAllocator>());
+
+    auto lp = LuaState::NewWithMemoryLimit(512 * 1024, 1024 * 1024);
+    assert(lp);
+    auto& l = *lp;
+    auto allocator = l.GetAllocator<LuaMemoryLimitAllocator>();
+    assert(allocator);
+
+    LuaMemoryLimitAllocator::Stats stats;
+    allocator->GetStats(&stats);
+    assert(stats.current_bytes > 0);
+    assert(stats.peak_bytes >= stats.current_bytes);
+    assert(stats.soft_limit == 512 * 1024);
+    assert(stats.hard_limit == 1024 * 1024);
+    assert(stats.soft_limit_hits == 0);
+
+    // garbage above the soft limit is collected by emergency gc
+    string errmsg;
+    bool ok = l.DoString("collectgarbage('stop'); for i = 1, 100 do "
+                         "local t = {}; for j = 1, 1000 do t[j] = j end end",
+                         &errmsg);
+    assert(ok);
+    allocator->GetStats(&stats);
+    assert(stats.soft_limit_hits > 0);
+    assert(stats.peak_bytes <= 1024 * 1024);
+
+
+    // live data above the hard limit fails
+    ok = l.DoString("t = {}; for i = 1, 1000 do "
+                    "t[i] = string.rep('x', 10000) .. i end",
+                    &errmsg);
+    assert(!ok);
+    assert(errmsg.find("not enough memory") != string::npos);
+    allocator->GetStats(&stats);
+    assert(stats.peak_bytes <= 1024 * 1024);
+
+    // the state is still usable after memory is released
+    ok = l.DoString("t = nil; collectgarbage(); result = 1 + 2", &errmsg);
+    assert(ok);
+    assert(l.GetInteger("result") == 3);
+    allocator->GetStats(&stats);
+    assert(stats.current_bytes < 512 * 1024);
+
+    // buffers above the soft limit and below the hard limit succeed
+    auto lp2 = LuaState::NewWithMemoryLimit(256 * 1024, 4 * 1024 * 1024);
+    assert(lp2);
+    ok = lp2->DoString("local s = string.rep('x', 1024 * 1024); "
+                       "s = table.concat({s, 'y'}); "
+                       "assert(#s == 1024 * 1024 + 1)",
+                       &errmsg);
+    assert(ok);
+}
+
+static void TestDisposableState() {
+    auto lp = LuaState::NewDisposable(16 * 1024);
+    assert(lp);
+    auto& l = *lp;
+    auto allocator = l.GetAllocator<LuaArenaAllocator>();
+    assert(allocator);
+
+    LuaArenaAllocator::Stats stats;
+    allocator->GetStats(&stats);
+    assert(stats.chunk_num > 0);
+    assert(stats.used_bytes <= stats.chunk_bytes);
+
+    // tables and strings growing across small and large blocks
+    string errmsg;
+    bool ok = l.DoString("t = {}; for i = 1, 10000 do t[i] = i end; "
+                         "s = ''; for i = 1, 1000 do s = s .. 'x' end; "
+                         "big = string.rep('y', 100000); "
+                         "sum = 0; for i = 1, #t do sum = sum + t[i] end",
+                         &errmsg);
+    assert(ok);
+    assert(l.GetInteger("sum") == 50005000);
+    assert(string(l.GetString("s")).size() == 1000);
+    assert(string(l.GetString("big")).size() == 100000);
+
+    LuaArenaAllocator::Stats stats2;
+    allocator->GetStats(&stats2);
+    assert(stats2.chunk_num > stats.chunk_num);
+    assert(stats2.used_bytes > stats.used_bytes);
+    assert(stats2.large_blocks > 0);
+    assert(stats2.large_bytes >= 100000);
+
+    // freed large blocks are released
+    ok = l.DoString("t = nil; big = nil; collectgarbage()", &errmsg);
+    assert(ok);
+    allocator->GetStats(&stats);
+    assert(stats.large_bytes < stats2.large_bytes);
+    assert(stats.chunk_bytes == stats2.chunk_bytes);
+}
+
+static int ArenaAllocatorShrinkWithoutMemory() {
+    LuaArenaAllocator allocator(16 * 1024);
+    auto alloc = allocator.GetAllocFunc();
+
+    // leaves no room in the current chunk
+    if (!alloc(&allocator, nullptr, 0, 16 * 1024)) {
+        return 1;
+    }
+    auto large = (char*)alloc(&allocator, nullptr, 0, 8192);
+    if (!large) {
+        return 1;
+    }
+    memset(large, 'x', 8192);
+
+    if (!ExhaustMemory()) {
+        return 2;
+    }
+
+    LuaArenaAllocator::Stats stats;
+    allocator.GetStats(&stats);
+    if (alloc(&allocator, large, 8192, 64) != large || large[63] != 'x') {
+        return 3;
+    }
+
+    // the block is kept as a chunk
+    LuaArenaAllocator::Stats stats2;
+    allocator.GetStats(&stats2);
+    if (stats2.large_blocks != stats.large_blocks - 1 ||
+        stats2.chunk_num != stats.chunk_num + 1) {
+        return 4;
+    }
+    alloc(&allocator, large, 64, 0);
+    return 0;
+}
+
+static void TestArenaAllocatorShrink() {
+    RunInChild(ArenaAllocatorShrinkWithoutMemory);
+}
+
+static void TestGcControl() {
+    LuaState l(luaL_newstate(), true);
+
+    l.GcStop();
+    assert(!l.GcIsRunning());
+    l.GcRestart();
+    assert(l.GcIsRunning());
+
+    // lua 5.4 stores these parameters divided by 4
+    int pause = l.GcSetPause(160);
+    assert(l.GcSetPause(pause) == 160);
+    int stepmul = l.GcSetStepMul(300);
+    assert(l.GcSetStepMul(stepmul) == 300);
+
+#if LUA_VERSION_NUM >= 504
+    assert(l.GcSetGenerational() == LUA_GCINC);
+    assert(l.GcSetIncremental() == LUA_GCGEN);
+#endif
+
+    // gc work is done by steps even if the collector is stopped
+    l.GcStop();
+    bool ok = l.DoString("for i = 1, 10000 do local t = {i} end");
+    assert(ok);
+    auto usage = l.GetMemoryUsage();
+
+    bool finished = false;
+    for (int i = 0; i < 10000 && !finished; ++i) {
+        finished = l.GcStepFor(chrono::microseconds(100));
+    }
+    assert(finished);
+    assert(l.GetMemoryUsage() < usage);
+    assert(!l.GcIsRunning());
+
+    l.GcRestart();
+    l.GcCollect();
+    assert(l.GetMemoryUsage() > 0);
+}
+
+static void WriteTestFile(const string& fpath, const char* content) {
+    FILE* fp = fopen(fpath.c_str(), "wb");
+    assert(fp);
+    fputs(content, fp);
+    fclose(fp);
+}
+
+static uint32_t CountBytecodeCacheFiles(const string& dir) {
+    uint32_t count = 0;
+    DIR* dp = opendir(dir.c_str());
+    assert(dp);
+    for (auto ent = readdir(dp); ent; ent = readdir(dp)) {
+        if (strstr(ent->d_name, ".luac")) {
+            ++count;
+        }
+    }
+    closedir(dp);
+    return count;
+}
+
+static void TestBytecodeCache() {
+    char tmpl[] = "/tmp/luacpp_test_XXXXXX";
+    string dir = mkdtemp(tmpl);
+    string script = dir + "/script.lua";
+    WriteTestFile(script, "x = 1 + 2");
+
+    string errstr;
+    {
+        LuaState l(luaL_newstate(), true);
+
+        // directories writable by others or missing are rejected
+        chmod(dir.c_str(), 0777);
+        assert(!l.SetBytecodeCacheDir(dir.c_str(), &errstr));
+        assert(errstr.find("writable") != string::npos);
+        chmod(dir.c_str(), 0700);
+        assert(!l.SetBytecodeCacheDir(script.c_str(), &errstr));
+        assert(!l.SetBytecodeCacheDir((dir + "/none").c_str(), &errstr));
+        assert(l.DoFile(script.c_str(), &errstr));
+        assert(CountBytecodeCacheFiles(dir) == 0);
+
+        assert(l.SetBytecodeCacheDir(dir.c_str(), &errstr));
+        assert(l.DoFile(script.c_str(), &errstr));
+        assert(l.GetInteger("x") == 3);
+        assert(CountBytecodeCacheFiles(dir) == 1);
+    }
+
+    // loaded from the cache by another state
+    {
+        LuaState l(luaL_newstate(), true);
+        l.SetBytecodeCacheDir(dir.c_str());
+        assert(l.DoFile(script.c_str(), &errstr));
+        assert(l.GetInteger("x") == 3);
+    }
+
+    // modified scripts of the same size are compiled again
+    WriteTestFile(script, "x = 4 + 5");
+    {
+        LuaState l(luaL_newstate(), true);
+        l.SetBytecodeCacheDir(dir.c_str());
+        assert(l.DoFile(script.c_str(), &errstr));
+        assert(l.GetInteger("x") == 9);
+        assert(CountBytecodeCacheFiles(dir) == 1);
+    }
+
+    // cache files of older formats are ignored and rewritten
+    DIR* dp = opendir(dir.c_str());
+    for (auto ent = readdir(dp); ent; ent = readdir(dp)) {
+        if (strstr(ent->d_name, ".luac")) {
+            FILE* fp = fopen((dir + "/" + ent->d_name).c_str(), "r+b");
+            assert(fp);
+            fseek(fp, 7, SEEK_SET);
+            fputc('C', fp); // "LUACPPBC" of version 1
+            fclose(fp);
+        }
+    }
+    closedir(dp);
+    {
+        LuaState l(luaL_newstate(), true);
+        l.SetBytecodeCacheDir(dir.c_str());
+        assert(l.DoFile(script.c_str(), &errstr));
+        assert(l.GetInteger("x") == 9);
+    }
+
+    // corrupt cache files are ignored and rewritten
+    dp = opendir(dir.c_str());
+    for (auto ent = readdir(dp); ent; ent = readdir(dp)) {
+        if (strstr(ent->d_name, ".luac")) {
+            WriteTestFile(dir + "/" + ent->d_name, "garbage");
+        }
+    }
+    closedir(dp);
+    {
+        LuaState l(luaL_newstate(), true);
+        l.SetBytecodeCacheDir(dir.c_str());
+        assert(l.DoFile(script.c_str(), &errstr));
+        assert(l.GetInteger("x") == 9);
+    }
+
+    // syntax errors are reported as usual
+    string bad_script = dir + "/bad.lua";
+    WriteTestFile(bad_script, "x = = 1");
+    {
+        LuaState l(luaL_newstate(), true);
+        l.SetBytecodeCacheDir(dir.c_str());
+        assert(!l.DoFile(bad_script.c_str(), &errstr));
+        assert(errstr.find("bad.lua") != string::npos);
+        assert(CountBytecodeCacheFiles(dir) == 1);
+    }
+
+    // the BOM and the first line starting with '#' are skipped like lua
+    string shebang_script = dir + "/shebang.lua";
+    WriteTestFile(shebang_script,
+                  "\xEF\xBB\xBF#!/usr/bin/env lua\ny = 1\nerror('oops')");
+    for (int i = 0; i < 2; ++i) {
+        LuaState l(luaL_newstate(), true);
+        l.SetBytecodeCacheDir(dir.c_str());
+        assert(!l.DoFile(shebang_script.c_str(), &errstr));
+        assert(errstr.find("shebang.lua:3: oops") != string::npos);
+        assert(l.GetInteger("y") == 1);
+        assert(CountBytecodeCacheFiles(dir) == 2);
+    }
+
+    dp = opendir(dir.c_str());
+    for (auto ent = readdir(dp); ent; ent = readdir(dp)) {
+        if (ent->d_name[0] != '.') {
+            remove((dir + "/" + ent->d_name).c_str());
+        }
+    }
+    closedir(dp);
+    rmdir(dir.c_str());
+}
+
+static void TestChunkCache() {
+    LuaState l(luaL_newstate(), true);
+    l.SetChunkCacheSize(2);
+
+    string errstr;
+    assert(l.DoString("n = (n or 0) + 1", &errstr));
+    assert(l.DoString("n = (n or 0) + 1", &errstr));
+    assert(l.GetInteger("n") == 2);
+
+    LuaChunkCache::Stats stats;
+    l.GetChunkCacheStats(&stats);
+    assert(stats.hits == 1);
+    assert(stats.misses == 1);
+    assert(stats.size == 1);
+    assert(stats.capacity == 2);
+
+    // the least recently used chunk is evicted
+    assert(l.DoString("m = 1", &errstr));
+    assert(l.DoString("n = (n or 0) + 1", &errstr));
+    assert(l.DoString("k = 1", &errstr));
+    l.GetChunkCacheStats(&stats);
+    assert(stats.size == 2);
+    assert(l.DoString("n = (n or 0) + 1", &errstr));
+    assert(l.DoString("m = 1", &errstr));
+    l.GetChunkCacheStats(&stats);
+    assert(stats.hits == 3);
+    assert(stats.misses == 4);
+    assert(l.GetInteger("n") == 4);
+
+    // errors are not cached
+    assert(!l.DoString("x = = 1", &errstr));
+    assert(!l.DoString("x = = 1", &errstr));
+    l.GetChunkCacheStats(&stats);
+    assert(stats.misses == 6);
+    assert(stats.size == 2);
+
+    // values returned by cached chunks
+    assert(l.DoString("return 5", &errstr));
+    bool called = false;
+    assert(l.DoString("return 5", &errstr,
+                      [&called](uint32_t, const LuaObject& lobj) -> bool {
+                          called = true;
+                          assert(lobj.ToInteger() == 5);
+                          return true;
+                      }));
+    assert(called);
+
+    l.SetChunkCacheSize(0);
+    l.GetChunkCacheStats(&stats);
+    assert(stats.size == 0);
+    assert(l.DoString("n = (n or 0) + 1", &errstr));
+    assert(l.GetInteger("n") == 5);
+
+    // states that do not own `lua_State` release cached chunks
+    lua_State* raw = luaL_newstate();
+    {
+        LuaState borrowed(raw, false);
+        borrowed.SetChunkCacheSize(8);
+        assert(borrowed.DoString("y = 1", &errstr));
+    }
+    lua_close(raw);
+}
+
+static void TestDoMapped() {
+    char tmpl[] = "/tmp/luacpp_test_XXXXXX";
+    string dir = mkdtemp(tmpl);
+    string script = dir + "/script.lua";
+    string bytecode = dir + "/script.luac";
+    string empty = dir + "/empty.lua";
+
+    LuaState l(luaL_newstate(), true);
+    string errstr;
+
+    // source code with a shebang line keeps line numbers
+    WriteTestFile(script, "#!/usr/bin/lua\nx = 1 + 2\nerror('oops')\n");
+    assert(!l.DoMapped(script.c_str(), &errstr));
+    assert(errstr.find("script.lua:3: oops") != string::npos);
+    assert(l.GetInteger("x") == 3);
+
+    // the UTF-8 BOM is skipped
+    WriteTestFile(script, "\xEF\xBB\xBF#!/usr/bin/lua\nx = 4\n");
+    assert(l.DoMapped(script.c_str(), &errstr));
+    assert(l.GetInteger("x") == 4);
+    WriteTestFile(script, "\xEF\xBB\xBFx = 5");
+    assert(l.DoMapped(script.c_str(), &errstr));
+    assert(l.GetInteger("x") == 5);
+
+    // precompiled chunks
+    l.CreateString(bytecode.c_str(), "path");
+    assert(l.DoString("local f = io.open(path, 'wb') "
+                      "f:write(string.dump(function() y = 10 end)) "
+                      "f:close()",
+                      &errstr));
+    assert(l.DoMapped(bytecode.c_str(), &errstr));
+    assert(l.GetInteger("y") == 10);
+
+    WriteTestFile(empty, "");
+    assert(l.DoMapped(empty.c_str(), &errstr));
+
+    assert(!l.DoMapped((dir + "/not_found.lua").c_str(), &errstr));
+    assert(errstr.find("cannot open") != string::npos);
+
+    // fifos and directories are not run as empty chunks
+    string fifo = dir + "/fifo.lua";
+    assert(mkfifo(fifo.c_str(), 0600) == 0);
+    assert(!l.DoMapped(fifo.c_str(), &errstr));
+    assert(errstr.find("not a regular file") != string::npos);
+    assert(!l.DoMapped(dir.c_str(), &errstr));
+    assert(errstr.find("not a regular file") != string::npos);
+
+    // buffers need not be null-terminated
+    const char* buf = "z = 5; return z * 2 -- garbage after the chunk";
+    auto func = l.LoadBuffer(buf, 19, "=buffer", &errstr);
+    assert(func.GetType() == LUA_TFUNCTION);
+    assert(l.Get("z").GetType() == LUA_TNIL);
+    bool called = false;
+    assert(func.Execute([&called](uint32_t, const LuaObject& res) -> bool {
+        called = true;
+        assert(res.ToInteger() == 10);
+        return true;
+    }));
+    assert(called);
+
+    func = l.LoadBuffer("z = = 1", 7, "=buffer", &errstr);
+    assert(func.GetType() == LUA_TNIL);
+    assert(errstr.find("buffer:1:") != string::npos);
+
+    remove(script.c_str());
+    remove(bytecode.c_str());
+    remove(empty.c_str());
+    remove(fifo.c_str());
+    rmdir(dir.c_str());
+}
+
+// gives `data` and then fails like a broken pipe
+class BrokenStreamBuf final : public streambuf {
+public:
+    BrokenStreamBuf(const string& data) : m_data(data), m_given(false) {}
+
+protected:
+    int_type underflow() override {
+        if (m_given) {
+            throw std::runtime_error("broken stream");
+        }
+        m_given = true;
+        auto p = const_cast<char*>(m_data.data());
+        setg(p, p, p + m_data.size());
+        return traits_type::to_int_type(*p);
+    }
+
+private:
+    string m_data;
+    bool m_given;
+};
+
+static void TestDoStream() {
+    LuaState l(luaL_newstate(), true);
+    string errstr;
+
+    istringstream iss("x = 1 + 2; return x * 2");
+    bool called = false;
+    assert(l.DoStream(iss, "=stream", &errstr,
+                      [&called](uint32_t, const LuaObject& res) -> bool {
+                          called = true;
+                          assert(res.ToInteger() == 6);
+                          return true;
+                      }));
+    assert(called);
+    assert(l.GetInteger("x") == 3);
+
+    // the reader feeds one byte at a time
+    const string chunk = "y = 'streamed'";
+    size_t offset = 0;
+    auto reader = [&chunk, &offset](size_t* size) -> const char* {
+        if (offset >= chunk.size()) {
+            return nullptr;
+        }
+        *size = 1;
+        return chunk.data() + offset++;
+    };
+    auto func = l.Load(reader, "=reader", &errstr);
+    assert(func.GetType() == LUA_TFUNCTION);
+    assert(l.Get("y").GetType() == LUA_TNIL);
+    assert(func.Execute());
+    assert(string(l.GetString("y")) == "streamed");
+
+    // precompiled chunks
+    assert(l.DoString("bc = string.dump(function() z = 7 end)", &errstr));
+    auto bc = l.GetStringRef("bc");
+    istringstream bss(string(bc.base, bc.size));
+    assert(l.DoStream(bss, "=bytecode", &errstr));
+    assert(l.GetInteger("z") == 7);
+
+    istringstream bad("x = = 1");
+    func = l.Load(bad, "=bad", &errstr);
+    assert(func.GetType() == LUA_TNIL);
+    assert(errstr.find("bad:1:") != string::npos);
+
+    istringstream empty("");
+    assert(l.DoStream(empty, "=empty", &errstr));
+
+    // streams broken in the middle are not run as truncated chunks
+    BrokenStreamBuf buf("w = 1; w = 2");
+    istream broken(&buf);
+    assert(!l.DoStream(broken, "=broken", &errstr));
+    assert(errstr == "cannot read broken");
+    assert(l.Get("w").GetType() == LUA_TNIL);
+
+    BrokenStreamBuf buf2("return 1");
+    istream broken2(&buf2);
+    func = l.Load(broken2, "=broken", &errstr);
+    assert(func.GetType() == LUA_TNIL);
+    assert(errstr == "cannot read broken");
+}
@@ -117,6 +117,79 @@ static void TestClassPropertyReadWrite() {
     cout << "in cpp, p1 is [" << p1->x << ", " << p1->y << "]" << endl;
 }
 
+static int GetPointX(const Point* p) {
+    return p->x;
+}
+
+static void SetPointX(Point* p, int v) {
+    p->x = v;
+}
+
+static void TestClassPropertyAccessorTypes() {
+    LuaState l(luaL_newstate(), true);
+
+    std::function<int(const Point*)> empty_getter;
+    std::function<void(Point*, int)> y_setter = [](Point* p, int v) -> void {
+        p->y = v;
+    };
+
+    auto lclass = l.CreateClass<Point>("Point")
+                      .DefConstructor()
+                      .DefMember<int>("x", GetPointX, &SetPointX)
+                      .DefMember<int>("y", empty_getter, y_setter);
+
+    auto lp = lclass.CreateInstance();
+    auto p = static_cast<Point*>(lp.ToPointer());
+    l.Set("p", lp);
+
+    string errmsg;
+    bool ok = l.DoString("p.x = p.x + 5; p.y = 100", &errmsg);
+    assert(ok);
+    assert(errmsg.empty());
+    assert(p->x == 15);
+    assert(p->y == 100);
+
+    // empty `std::function` means the property is not readable
+    ok = l.DoString("return p.y", &errmsg);
+    assert(!ok);
+    assert(errmsg.find("cannot read `y`") != string::npos);
+}
+
+static void TestClassField() {
+    LuaState l(luaL_newstate(), true);
+
+    auto lclass = l.CreateClass<Point>("Point")
+                      .DefConstructor()
+                      .DefField<decltype(&Point::x), &Point::x>("x")
+                      .DefReadOnlyField<decltype(&Point::y), &Point::y>("y");
+
+    auto lp = lclass.CreateInstance();
+    auto p = static_cast<Point*>(lp.ToPointer());
+    l.Set("p", lp);
+
+    string errmsg;
+    bool ok = l.DoString("p.x = p.x + p.y", &errmsg);
+    assert(ok);
+    assert(errmsg.empty());
+    assert(p->x == 30);
+
+    ok = l.DoString("p.y = 5", &errmsg);
+    assert(!ok);
+    assert(errmsg.find("cannot write `y`") != string::npos);
+    assert(p->y == 20);
+
+    // fields of base classes can be bound to derived classes
+    l.CreateClass<DerivedDemo1>("DerivedDemo1")
+        .DefConstructor()
+        .DefField<decltype(&ClassDemo::m_value), &ClassDemo::m_value>("value");
+    errmsg.clear();
+    ok = l.DoString("d = DerivedDemo1(); d.value = 12345", &errmsg);
+    assert(ok);
+    assert(errmsg.empty());
+    auto lud = l.Get("d");
+    assert(static_cast<DerivedDemo1*>(lud.ToPointer())->m_value == 12345);
+}
+
 static inline void GenericPrint(const char* msg) {
     cout << "C-style static member function: '" << msg << "'" << endl;
 }
@@ -208,6 +281,46 @@ static void TestClassStaticPropertyReadWrite() {
     cout << "errmsg -> '" << errmsg << "'" << endl;
 }
 
+static void TestClassForeignUserdata() {
+    LuaState l(luaL_newstate(), true);
+
+    l.CreateClass<ClassDemo>("ClassDemo").DefConstructor();
+
+    // userdata planted by scripts are not treated as properties
+    string errmsg;
+    bool ok = l.DoString("getmetatable(ClassDemo).evil = io.stdout; "
+                         "v1 = ClassDemo.evil; "
+                         "ClassDemo.evil = 5; "
+                         "local obj = ClassDemo(); "
+                         "getmetatable(obj).evil2 = io.stdout; "
+                         "v2 = obj.evil2",
+                         &errmsg);
+    assert(ok);
+    assert(l.Get("v1").GetType() == LUA_TNIL);
+    assert(l.Get("v2").GetType() == LUA_TNIL);
+}
+
+static void TestClassForeignLightUserdata() {
+    auto raw = luaL_newstate();
+    LuaState l(raw, true);
+
+    static int dummy = 0;
+    l.CreateClass<Point>("Point")
+        .DefField<decltype(&Point::x), &Point::x>("x");
+
+    // light userdata put by hosts are not treated as properties
+    lua_getglobal(raw, "Point");
+    lua_getmetatable(raw, -1);
+    lua_pushlightuserdata(raw, &dummy);
+    lua_setfield(raw, -2, "lud");
+    lua_pop(raw, 2);
+
+    string errmsg;
+    bool ok = l.DoString("v = Point.lud", &errmsg);
+    assert(ok);
+    assert(l.Get("v").GetType() == LUA_TNIL);
+}
+
 static void TestClassStaticMemberFunction() {
     LuaState l(luaL_newstate(), true);
 
@@ -230,6 +343,39 @@ static void TestClassStaticMemberFunction() {
     assert(ok);
 }
 
+static int GetPointSum(const Point* p) {
+    return p->x + p->y;
+}
+
+static int PointArgCount(lua_State* l) {
+    lua_pushinteger(l, lua_gettop(l));
+    return 1;
+}
+
+static void TestClassStaticBoundFunctions() {
+    LuaState l(luaL_newstate(), true);
+
+    l.CreateClass<Point>("Point")
+        .DefConstructor()
+        .DefMember<decltype(&GetPointSum), &GetPointSum>("sum")
+        .DefMember<decltype(&PointArgCount), &PointArgCount>("argc");
+    l.CreateClass<ClassDemo>("ClassDemo")
+        .DefConstructor()
+        .DefMember<int (ClassDemo::*)(int) const, &ClassDemo::Echo>("echo")
+        .DefStatic<decltype(&ClassDemo::StaticEcho), &ClassDemo::StaticEcho>(
+            "s_echo");
+
+    string errmsg;
+    bool ok = l.DoString(
+        "p = Point(); assert(p:sum() == 30); assert(p:argc(1, 2) == 3);"
+        "c = ClassDemo(); assert(c:echo(5) == 5);"
+        "assert(ClassDemo:s_echo('static') == 'static');"
+        "assert(c:s_echo('static') == 'static')",
+        &errmsg);
+    assert(ok);
+    assert(errmsg.empty());
+}
+
 static int PrintAllStr(lua_State* l) {
     int argc = lua_gettop(l);
     for (int i = 2; i <= argc; ++i) {
@@ -400,3 +546,77 @@ static void TestClassMemberInheritance3() {
     assert(ok);
     assert(errmsg.empty());
 }
+
+static size_t CountDerivedClasses(lua_State* l, const char* name) {
+    lua_getglobal(l, name);
+    lua_getiuservalue(l, -1, CLASS_CHILDREN_TABLE_IDX);
+    size_t n = 0;
+    lua_pushnil(l);
+    while (lua_next(l, -2) != 0) {
+        lua_pop(l, 1);
+        ++n;
+    }
+    lua_pop(l, 2);
+    return n;
+}
+
+static void TestClassAddBaseClassTwice() {
+    auto raw = luaL_newstate();
+    LuaState l(raw, true);
+
+    auto base = l.CreateClass<ClassDemo>("ClassDemo").DefConstructor();
+    {
+        auto derived = l.CreateClass<DerivedDemo1>()
+                           .AddBaseClass(base)
+                           .AddBaseClass(base)
+                           .DefConstructor();
+        assert(CountDerivedClasses(raw, "ClassDemo") == 1);
+
+        base.DefMember<const char* (ClassDemo::*)(const char*) const>(
+            "echo", &ClassDemo::Echo);
+        auto obj = derived.CreateInstance();
+        l.Set("d", obj);
+        string errmsg;
+        bool ok = l.DoString("assert(d:echo('twice') == 'twice')", &errmsg);
+        assert(ok);
+        assert(errmsg.empty());
+    }
+
+    // derived classes are not kept alive by base classes
+    l.DoString("d = nil; collectgarbage(); collectgarbage()");
+    assert(CountDerivedClasses(raw, "ClassDemo") == 0);
+    base.DefStatic("StaticEcho", &ClassDemo::StaticEcho);
+}
+
+static void TestClassMemberDefinedAfterInheritance() {
+    LuaState l(luaL_newstate(), true);
+
+    auto base = l.CreateClass<ClassDemo>("ClassDemo").DefConstructor();
+    auto derived1 = l.CreateClass<DerivedDemo1>("DerivedDemo1")
+                        .AddBaseClass(base)
+                        .DefConstructor();
+    l.CreateClass<DerivedDemo2>("DerivedDemo2")
+        .AddBaseClass(derived1)
+        .DefConstructor();
+
+    string errmsg;
+    bool ok = l.DoString("d2 = DerivedDemo2(); assert(d2.echo == nil)",
+                         &errmsg);
+    assert(ok);
+    assert(errmsg.empty());
+
+    // members added to base classes after instances are used are still visible
+    base.DefMember<const char* (ClassDemo::*)(const char*) const>(
+        "echo", &ClassDemo::Echo);
+    ok = l.DoString("assert(d2:echo('late') == 'late')", &errmsg);
+    assert(ok);
+    assert(errmsg.empty());
+
+    // members of derived classes hide those of base classes
+    derived1.DefMember("echo", [](const DerivedDemo1*, const char*) -> int {
+        return 1;
+    });
+    ok = l.DoString("assert(d2:echo('late') == 1)", &errmsg);
+    assert(ok);
+    assert(errmsg.empty());
+}
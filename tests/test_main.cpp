@@ -12,16 +12,39 @@ static const vector<pair<string, void (*)()>> g_test_suite = {
     TEST_CASE(TestLuaStatePush),
     TEST_CASE(TestNil),
     TEST_CASE(TestString),
+    TEST_CASE(TestInlineScalars),
+    TEST_CASE(TestSharedReferences),
+    TEST_CASE(TestScope),
     TEST_CASE(TestTable),
     TEST_CASE(TestTableGetSet),
+    TEST_CASE(TestTableArray),
+    TEST_CASE(TestTableForEachPrimitives),
+    TEST_CASE(TestTableKey),
+    TEST_CASE(TestTableCursor),
+    TEST_CASE(TestTablePath),
     TEST_CASE(TestFuncWithReturnValue),
+    TEST_CASE(TestFuncWithTypedResults),
+    TEST_CASE(TestFuncForEachCall),
     TEST_CASE(TestFuncWithoutReturnValue),
     TEST_CASE(TestFuncWithBuiltinReferenceTypes),
+    TEST_CASE(TestFuncWithStackViews),
     TEST_CASE(TestVariadicArguments),
+    TEST_CASE(TestLuaStyleLambda),
+    TEST_CASE(TestStaticBoundFunction),
     TEST_CASE(TestUserdata1),
     TEST_CASE(TestUserdata2),
     TEST_CASE(TestDoString),
     TEST_CASE(TestDoFile),
+    TEST_CASE(TestSlabAllocator),
+    TEST_CASE(TestSlabAllocatorShrink),
+    TEST_CASE(TestMemoryLimit),
+    TEST_CASE(TestDisposableState),
+    TEST_CASE(TestArenaAllocatorShrink),
+    TEST_CASE(TestGcControl),
+    TEST_CASE(TestBytecodeCache),
+    TEST_CASE(TestChunkCache),
+    TEST_CASE(TestDoMapped),
+    TEST_CASE(TestDoStream),
 
     // ----- test class ----- //
 
@@ -29,15 +52,22 @@ static const vector<pair<string, void (*)()>> g_test_suite = {
     TEST_CASE(TestClassConstructor),
     TEST_CASE(TestClassProperty),
     TEST_CASE(TestClassPropertyReadWrite),
+    TEST_CASE(TestClassPropertyAccessorTypes),
+    TEST_CASE(TestClassField),
     TEST_CASE(TestClassMemberFunction),
     TEST_CASE(TestClassLuaMemberFunction),
     TEST_CASE(TestClassStaticProperty),
     TEST_CASE(TestClassStaticPropertyReadWrite),
+    TEST_CASE(TestClassForeignUserdata),
+    TEST_CASE(TestClassForeignLightUserdata),
     TEST_CASE(TestClassStaticMemberFunction),
     TEST_CASE(TestClassLuaStaticMemberFunction),
+    TEST_CASE(TestClassStaticBoundFunctions),
     TEST_CASE(TestClassStaticMemberInheritance),
     TEST_CASE(TestClassMemberInheritance),
     TEST_CASE(TestClassMemberInheritance3),
+    TEST_CASE(TestClassMemberDefinedAfterInheritance),
+    TEST_CASE(TestClassAddBaseClassTwice),
 };
 
 int main(void) {